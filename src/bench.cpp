@@ -0,0 +1,299 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "./lib/Lexer.hpp"
+#include "./lib/Source.hpp"
+#include "./lib/Exception.hpp"
+#include "./lib/Scrypt.hpp"
+#include "./lib/Output.hpp"
+#include "./lib/Printer.hpp"
+#include "./lib/Optimizer.hpp"
+#include "./lib/TypeInference.hpp"
+#include "./lib/Jit.hpp"
+#include "./lib/Stats.hpp"
+
+namespace {
+
+// Discards everything written to it, print output is not part of the measurement
+class NullBuffer : public std::streambuf {
+    protected:
+        int overflow(int c) override { return c; }
+        std::streamsize xsputn(const char *, std::streamsize n) override { return n; }
+};
+
+struct Samples {
+    size_t iterations = 0;
+    std::vector<double> seconds;  // one entry per iteration
+    double allocations = 0;       // per iteration
+    double allocated_bytes = 0;   // per iteration
+};
+
+struct Options {
+    double budget = 0.25;     // seconds spent on each phase of each program
+    size_t min_iterations = 5;
+    size_t max_iterations = 100000;
+    bool optimize = true;
+    bool use_jit = true;
+    std::string output;       // stdout if empty
+};
+
+// Runs setup (untimed) and run until the budget is spent, at least
+// min_iterations and at most max_iterations times, after one warm-up round.
+// A setup much slower than run also ends it, at four times the budget.
+template <typename Setup, typename Run>
+Samples measure(const Options &options, Setup setup, Run run) {
+    using Clock = std::chrono::steady_clock;
+    Samples stats;
+    setup();
+    run();
+
+    size_t count = 0, bytes = 0;
+    double total = 0;
+    auto began = Clock::now();
+    auto wall = [&] { return std::chrono::duration<double>(Clock::now() - began).count(); };
+    while (stats.iterations < options.max_iterations
+           && (stats.iterations < options.min_iterations
+               || (total < options.budget && wall() < 4 * options.budget))) {
+        setup();
+        size_t count_before = Stats::allocations(), bytes_before = Stats::allocated_bytes();
+        auto start = Clock::now();
+        run();
+        auto stop = Clock::now();
+        count += Stats::allocations() - count_before;
+        bytes += Stats::allocated_bytes() - bytes_before;
+        double elapsed = std::chrono::duration<double>(stop - start).count();
+        stats.seconds.push_back(elapsed);
+        total += elapsed;
+        ++stats.iterations;
+    }
+    stats.allocations = static_cast<double>(count) / stats.iterations;
+    stats.allocated_bytes = static_cast<double>(bytes) / stats.iterations;
+    return stats;
+}
+
+// Nearest-rank percentile of sorted, p in [0, 100]
+double percentile(const std::vector<double> &sorted, double p) {
+    size_t rank = static_cast<size_t>(p / 100 * sorted.size() + 0.5);
+    return sorted[std::min(sorted.size() - 1, rank ? rank - 1 : 0)];
+}
+
+std::string json_string(const std::string &text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (c == '\n') { out += "\\n"; continue; }
+        out += c;
+    }
+    return out + '"';
+}
+
+void write_stats(std::ostream &out, const std::string &phase, Samples stats, size_t bytes) {
+    std::sort(stats.seconds.begin(), stats.seconds.end());
+    double total = 0;
+    for (double s : stats.seconds)
+        total += s;
+    double mean = total / stats.iterations;
+    out << "        " << json_string(phase) << ": {"
+        << "\"iterations\": " << stats.iterations
+        << ", \"mean_us\": " << mean * 1e6
+        << ", \"p50_us\": " << percentile(stats.seconds, 50) * 1e6
+        << ", \"p90_us\": " << percentile(stats.seconds, 90) * 1e6
+        << ", \"p99_us\": " << percentile(stats.seconds, 99) * 1e6
+        << ", \"max_us\": " << stats.seconds.back() * 1e6
+        << ", \"mb_per_s\": " << (mean > 0 ? bytes / mean / 1e6 : 0)
+        << ", \"runs_per_s\": " << (mean > 0 ? 1 / mean : 0)
+        << ", \"allocations\": " << stats.allocations
+        << ", \"allocated_bytes\": " << stats.allocated_bytes
+        << "}";
+}
+
+// The built-in corpus, each program stresses a different part of the pipeline
+struct Workload {
+    std::string name;
+    std::string text;
+};
+
+// Start value the optimizer cannot fold away
+const char *SEED = "seed = 0;\nwhile seed < 3 {\n    seed = seed + 1;\n}\n";
+
+std::vector<Workload> corpus() {
+    std::vector<Workload> programs;
+
+    programs.push_back({"collatz",
+        "n = 1;\ntotal = 0;\nwhile n < 3000 {\n    x = n;\n    while x > 1 {\n"
+        "        total = total + 1;\n        if x % 2 == 0 {\n            x = x / 2;\n        }\n"
+        "        else {\n            x = 3 * x + 1;\n        }\n    }\n    n = n + 1;\n}\nprint total;\n"});
+
+    programs.push_back({"recursion",
+        "def fib(n) {\n    if n < 2 {\n        return n;\n    }\n"
+        "    return fib(n - 1) + fib(n - 2);\n}\nprint fib(20);\n"});
+
+    std::ostringstream nested;
+    nested << SEED;
+    const int depth = 200;
+    for (int i = 0; i < depth; ++i)
+        nested << std::string(4 * i, ' ') << "if seed < " << 1000 + i << " {\n"
+               << std::string(4 * i + 4, ' ') << "seed = seed + 1;\n";
+    for (int i = depth - 1; i >= 0; --i)
+        nested << std::string(4 * i, ' ') << "}\n";
+    nested << "print seed;\n";
+    programs.push_back({"nesting", nested.str()});
+
+    std::ostringstream straight;
+    straight << SEED << "v = seed;\n";
+    for (int i = 0; i < 5000; ++i)
+        straight << "v = (v * 3 + " << i << ") % 1000;\n";
+    straight << "print v;\n";
+    programs.push_back({"straight_line", straight.str()});
+
+    std::ostringstream variables;
+    variables << SEED << "v0 = seed;\n";
+    for (int i = 1; i < 2000; ++i)
+        variables << "v" << i << " = v" << i - 1 << " + " << i % 7 << ";\n";
+    variables << "print v1999;\n";
+    programs.push_back({"variables", variables.str()});
+
+    return programs;
+}
+
+void bench(std::ostream &out, const Options &options, const Workload &program) {
+    std::string_view text = program.text;
+    Lexer lexer;
+    TokenStream tokens = lexer.tokenize(text);
+    // Errors are reported before anything is timed
+    std::shared_ptr<Program> parsed = Scrypt::Parser(tokens).parse();
+
+    NullBuffer null_buffer;
+    std::ostream null_stream(&null_buffer);
+    size_t bytes = text.size();
+
+    out << "    {\"name\": " << json_string(program.name)
+        << ", \"bytes\": " << bytes
+        << ", \"tokens\": " << tokens.size()
+        << ", \"phases\": {\n";
+
+    TokenStream lexed;
+    write_stats(out, "lex", measure(options,
+        [&] { lexed = TokenStream(); },
+        [&] { lexed = lexer.tokenize(text); }), bytes);
+    out << ",\n";
+
+    // Parsing includes the resolver, the program is freed outside the timing
+    std::shared_ptr<Program> result;
+    write_stats(out, "parse", measure(options,
+        [&] { result.reset(); },
+        [&] { result = Scrypt::Parser(tokens).parse(); }), bytes);
+    out << ",\n";
+
+    if (options.optimize) {
+        write_stats(out, "optimize", measure(options,
+            [&] { result = Scrypt::Parser(tokens).parse(); },
+            [&] {
+                Optimizer().optimize(*result);
+                TypeInference().infer(*result);
+            }), bytes);
+        out << ",\n";
+    }
+
+    // Every run starts from a fresh parse and an empty JIT
+    std::unique_ptr<Jit> jit;
+    std::unique_ptr<Output> output;
+    write_stats(out, "eval", measure(options,
+        [&] {
+            output.reset();
+            result = Scrypt::Parser(tokens).parse();
+            if (options.optimize) {
+                Optimizer().optimize(*result);
+                TypeInference().infer(*result);
+            }
+            jit = std::make_unique<Jit>();
+            output = std::make_unique<Output>(null_stream);
+        },
+        [&] {
+            result->eval(*output, options.use_jit ? jit.get() : nullptr);
+            output->flush();
+        }), bytes);
+    out << ",\n";
+
+    Output formatted(null_stream);
+    write_stats(out, "format", measure(options,
+        [] {},
+        [&] {
+            Printer(formatted).print(parsed->root);
+            formatted.put('\n');
+            formatted.flush();
+        }), bytes);
+    out << "\n    }}";
+}
+
+void usage() {
+    std::cerr << "usage: bench [--output FILE] [--budget SECONDS] [--no-opt] [--no-jit] [FILE...]\n"
+              << "  runs the built-in corpus, or the programs given, and writes the results as JSON\n";
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--output" && i + 1 < argc) options.output = argv[++i];
+        else if (arg == "--budget" && i + 1 < argc) options.budget = std::atof(argv[++i]);
+        else if (arg == "--no-opt") options.optimize = false;
+        else if (arg == "--no-jit") options.use_jit = false;
+        else if (arg == "--help" || arg.rfind("--", 0) == 0) { usage(); return arg == "--help" ? 0 : 1; }
+        else paths.push_back(arg);
+    }
+
+    std::vector<Workload> programs;
+    try {
+        if (paths.empty())
+            programs = corpus();
+        for (auto &path : paths)
+            programs.push_back({path, std::string(Source(path).text())});
+    }
+    catch (std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::ostringstream out;
+    out << "{\n  \"budget_s\": " << options.budget
+        << ",\n  \"optimize\": " << (options.optimize ? "true" : "false")
+        << ",\n  \"jit\": " << (options.use_jit ? "true" : "false")
+        << ",\n  \"programs\": [\n";
+    for (size_t i = 0; i < programs.size(); ++i) {
+        try {
+            std::cerr << "bench: " << programs[i].name << std::endl;
+            bench(out, options, programs[i]);
+        }
+        catch (ScryptException &e) {
+            std::cerr << programs[i].name << ": " << e.what() << std::endl;
+            return e.code();
+        }
+        out << (i + 1 < programs.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+
+    if (options.output.empty()) {
+        std::cout << out.str();
+    }
+    else {
+        std::ofstream file(options.output);
+        if (!(file << out.str())) {
+            std::cerr << "bench: cannot write " << options.output << std::endl;
+            return 1;
+        }
+        std::cerr << "bench: results written to " << options.output << std::endl;
+    }
+    return 0;
+}
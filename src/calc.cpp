@@ -10,37 +10,49 @@
 #include "./lib/Infix.hpp"
 #include "./lib/Lexer.hpp"
 #include "./lib/Exception.hpp"
+#include "./lib/Stats.hpp"
 
 int main() {
-    std::deque<Token> tokens;
+    // Written when main returns if SCRYPT_STATS is set, phases add up over all lines
+    Stats stats("calc");
+    TokenStream tokens;
     Lexer lexer;
     
     std::string line;
-    std::stringstream ss;
     auto global_sp = std::make_shared<Environment>(Environment());
     while (std::getline(std::cin, line)) {
-        // this offsets col number by 1
-        ss << "(" << line << ")";
         try {
-            tokens = lexer.tokenize(ss, 1);
+            {
+                Stats::Timer timer(stats, Stats::Phase::lex);
+                tokens = lexer.tokenize(line);
+            }
+            stats.count_tokens(tokens.size());
             // Calc does not support statements
-            for (Token token : tokens) {
-                if (token.type == Type::statement)
-                    throw UnexpectedToken(token);
+            for (size_t i = 0; i < tokens.size(); ++i) {
+                if (tokens.type(i) == Type::statement)
+                    throw UnexpectedToken(tokens[i]);
             }
+            // Each line is parsed once, then evaluated and printed from the same AST
             Infix::Parser parser(tokens);
-            auto x = parser.eval(global_sp);
-            if (parser.parse(global_sp)->token.type != Type::op || tokens.front().type != Type::left_paren)
-                std::cout << parser.parse(global_sp)->to_string() << std::endl;
-            else
-                std::cout << parser.parse(global_sp)->to_string() << std::endl;
+            ASTNode *ast;
+            {
+                Stats::Timer timer(stats, Stats::Phase::parse);
+                ast = parser.parse();
+            }
+            stats.count_nodes(parser.program->locations.size());
+            stats.arena(parser.program->arena.bytes_reserved());
+            std::pair<int, std::string> x;
+            {
+                Stats::Timer timer(stats, Stats::Phase::eval);
+                x = parser.eval(ast, global_sp);
+            }
+            stats.environment(global_sp->values.size());
+            std::cout << ast->to_string() << std::endl;
             std::cout << x.second << std::endl;
         }
         catch(ScryptException& e) {
             std::cout << e.what() << std::endl;
         }
-        ss.str(std::string());
-        ss.clear();
     }
     return 0;
 }
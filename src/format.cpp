@@ -5,19 +5,34 @@
 #include <cctype>
 #include <iomanip>
 #include <algorithm>
+#include <memory>
+#include <stdexcept>
 
 #include "./lib/Lexer.hpp"
+#include "./lib/Source.hpp"
 #include "./lib/Exception.hpp"
 #include "./lib/Infix.hpp"
 #include "./lib/Scrypt.hpp"
+#include "./lib/Output.hpp"
+#include "./lib/Printer.hpp"
+#include "./lib/Stats.hpp"
 
 
-int main() {
+int main(int argc, char *argv[]) {
+    // Written when main returns if SCRYPT_STATS is set
+    Stats stats("format");
+    // Tokens are views of the source, read from the file given or stdin
+    std::unique_ptr<Source> source;
     Lexer lexer;
-    std::deque<Token> tokens;
+    TokenStream tokens;
 
     try {
-        tokens = lexer.tokenize(std::cin);
+        source = argc > 1 ? std::make_unique<Source>(std::string(argv[1])) : std::make_unique<Source>(std::cin);
+        {
+            Stats::Timer timer(stats, Stats::Phase::lex);
+            tokens = lexer.tokenize(source->text());
+        }
+        stats.count_tokens(tokens.size());
 
         // for (Token token : tokens) {
         //     std::cout << std::right << std::setw(4) << token.line_number 
@@ -26,13 +41,31 @@ int main() {
         // }
 
         Scrypt::Parser parser(tokens);
-        auto x = parser.parse();
-        std::cout << x->to_string() << std::endl;
+        std::shared_ptr<Program> x;
+        {
+            Stats::Timer timer(stats, Stats::Phase::parse);
+            x = parser.parse();
+        }
+        stats.count_nodes(x->locations.size());
+        stats.arena(x->arena.bytes_reserved());
+        for (auto &env : x->environments)
+            stats.environment(env->values.size());
+        // Stream the formatted program instead of building it as one string
+        Stats::Timer timer(stats, Stats::Phase::format);
+        Output output(std::cout);
+        Printer(output).print(x->root);
+        output.put('\n');
     }
     catch(ScryptException& e) {
         std::cout << e.what() << std::endl;
+        stats.exit_code(e.code());
         return e.code();  // Exit with the error code from the exception
     }
+    catch(std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        stats.exit_code(1);
+        return 1;
+    }
 
     return 0;
 }
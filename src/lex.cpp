@@ -5,29 +5,49 @@
 #include <cctype>
 #include <iomanip>
 #include <algorithm>
+#include <memory>
+#include <stdexcept>
 #include "./lib/Lexer.hpp"
+#include "./lib/Source.hpp"
 #include "./lib/Exception.hpp"
+#include "./lib/Stats.hpp"
 
 /*
- * This program tokenizes the input from the standard input stream using the Lexer class.
+ * This program tokenizes the input from the standard input stream, or the file named
+ * by its argument, using the Lexer class.
  * The tokens are then displayed in the format: [line number][column number][token text].
  * If an ScryptException occurs during tokenization, the program outputs the error message 
  * and exits with the error code obtained from the exception.
  */
-int main()
+int main(int argc, char *argv[])
 {
+    // Written when main returns if SCRYPT_STATS is set
+    Stats stats("lex");
+    // Tokens are views of the source, read from the file given or stdin
+    std::unique_ptr<Source> source;
     Lexer lexer;
-    std::deque<Token> tokens;
+    TokenStream tokens;
 
     try {
-        tokens = lexer.tokenize(std::cin);
+        source = argc > 1 ? std::make_unique<Source>(std::string(argv[1])) : std::make_unique<Source>(std::cin);
+        Stats::Timer timer(stats, Stats::Phase::lex);
+        tokens = lexer.tokenize(source->text());
     }
     catch(ScryptException& e) {
         std::cout << e.what() << std::endl;
+        stats.exit_code(e.code());
         return e.code();  // Exit with the error code from the exception
     }
+    catch(std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        stats.exit_code(1);
+        return 1;
+    }
+    stats.count_tokens(tokens.size());
 
-    for (Token token : tokens) {
+    // Printing the tokens is not one of the timed phases
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        Token token = tokens[i];
         std::cout << std::right << std::setw(4) << token.line_number 
                   << std::setw(5) << token.column_number 
                   << "  " << token.text << std::endl;
@@ -2,286 +2,288 @@
 #include <vector>
 #include <functional>
 #include <numeric>
-#include <variant>
 #include <cmath>
+#include <sys/resource.h>
 
 #include "ASTNode.hpp"
 #include "Environment.hpp"
 #include "Exception.hpp"
 #include "ValueSum.hpp"
+#include "Printer.hpp"
+#include "Jit.hpp"
+#include "Profiler.hpp"
+#include "Symbols.hpp"
 
-std::ostringstream GLOBAL_COUT;
+
+std::string ASTNode::to_string() { return Printer::to_string(this); }
 
 // Constructor to initialize a value from a given token.
-Value::Value(Token token, std::shared_ptr<Environment> env) { 
-    this->token = token; 
-    this->env = env;
+Value::Value(const Token &token) { 
+    this->type = token.type;
     if (token.type == Type::number)
-        val = ValueSum{std::stod(token.text)};
+        val = ValueSum{std::stod(std::string(token.text))};
     else if (token.type == Type::boolean)
         val = ValueSum{(token.text == "true")};
     else if (token.type == Type::null)
         val = ValueSum{nullptr};
 }
 
-ValueSum Value::eval() { return val; }
+Value::Value(ValueSum val) : val(val) {
+    if (is_number(val))     this->type = Type::number;
+    else if (is_bool(val))  this->type = Type::boolean;
+    else                    this->type = Type::null;
+}
+
+ValueSum Value::eval(Frame &) { return val; }
 // Converts the number to a string representation ensuring that there are no unnecessary trailing zeros.
 std::string Value::to_string() { 
     return vsum_to_string(val);
 }
 
-std::string Identifier::to_string() { return token.text; }
+std::string Identifier::to_string() { return std::string(name); }
 
-Identifier::Identifier(Token token, std::shared_ptr<Environment> env) {
-    this->token = token;
-    this->env = env;
+Identifier::Identifier(uint32_t atom) : name(Symbols::table().name(atom)), atom(atom) {
+    this->type = Type::identifier;
 }
 
-ValueSum Identifier::eval() {
-    return env->get(token.text);
+ValueSum Identifier::eval(Frame &frame) {
+    return frame.get(slot);
 }
 
-// Constructor to initialize an operator from a given token.
-Operator::Operator(Token token, std::shared_ptr<Environment> env) { 
-    this->token = token; 
-    this->env = env;
+OpKind decode_op(std::string_view text) {
+    if (text.empty() || text.length() > 2)
+        return OpKind::none;
+    bool eq = text.length() == 2;
+    if (eq && text[1] != '=')
+        return OpKind::none;
+    switch (text[0]) {
+        case '+': return eq ? OpKind::none : OpKind::add;
+        case '-': return eq ? OpKind::none : OpKind::sub;
+        case '*': return eq ? OpKind::none : OpKind::mul;
+        case '/': return eq ? OpKind::none : OpKind::div;
+        case '%': return eq ? OpKind::none : OpKind::mod;
+        case '<': return eq ? OpKind::less_equal : OpKind::less;
+        case '>': return eq ? OpKind::greater_equal : OpKind::greater;
+        case '=': return eq ? OpKind::equal : OpKind::assign;
+        case '!': return eq ? OpKind::not_equal : OpKind::none;
+        case '&': return eq ? OpKind::none : OpKind::logic_and;
+        case '^': return eq ? OpKind::none : OpKind::logic_xor;
+        case '|': return eq ? OpKind::none : OpKind::logic_or;
+        default:  return OpKind::none;
+    }
 }
 
-// Converts the operator and its sub-expressions to a string representation in infix notation.
-std::string Operator::to_string() {
-    std::ostringstream oss;
-    try {
-        oss << "(";
-        if (sub_expr.size() > 1) {
-            if (token.text == "=") {
-                oss << sub_expr.back()->to_string();
-                for (unsigned int i = sub_expr.size() - 2; i < sub_expr.size(); --i) {
-                    oss << " " << token.text << " ";
-                    oss << sub_expr[i]->to_string();
-                }
-            }
-            else {
-                oss << sub_expr[0]->to_string();
-                for (unsigned int i = 1; i < sub_expr.size(); ++i) {
-                    oss << " " << token.text << " ";
-                    oss << sub_expr[i]->to_string();
-                }
-            }
-        }
-        oss << ")";
-    }
-    catch(ScryptException& e) {
-        // Handle exceptions that may occur during string conversion.
-        std::cout << e.what() << std::endl;
-        exit(e.code());
+const char *op_text(OpKind kind) {
+    static const char *text[] = {
+        "+", "-", "*", "/", "%",
+        "<", "<=", ">", ">=",
+        "==", "!=",
+        "&", "^", "|",
+        "=",
+        ""
+    };
+    return text[static_cast<int>(kind)];
+}
+
+// Constructor to initialize an operator from its decoded kind.
+Operator::Operator(Arena &arena, OpKind kind, Type type)
+    : sub_expr(arena), assign_slots(arena), kind(kind) { 
+    this->type = type;
+}
+
+// Operands as numbers or bools, with or without the type check
+template <bool Checked>
+static inline double number(const ValueSum &val) { return Checked ? get_number(val) : number_of(val); }
+template <bool Checked>
+static inline bool boolean(const ValueSum &val) { return Checked ? get_bool(val) : bool_of(val); }
+
+template <bool Checked>
+static ValueSum apply(OpKind kind, const ValueSum &v1, const ValueSum &v2) {
+    switch (kind) {
+        case OpKind::add:
+            return ValueSum{number<Checked>(v1) + number<Checked>(v2)};
+        case OpKind::sub:
+            return ValueSum{number<Checked>(v1) - number<Checked>(v2)};
+        case OpKind::mul:
+            return ValueSum{number<Checked>(v1) * number<Checked>(v2)};
+        case OpKind::div:
+            if (number<Checked>(v2) == 0)
+                throw RuntimeError("Runtime error: division by zero.");
+            return ValueSum{number<Checked>(v1) / number<Checked>(v2)};
+        case OpKind::mod:
+            if (number<Checked>(v2) == 0)
+                throw RuntimeError("Runtime error: division by zero.");
+            return ValueSum{std::fmod(number<Checked>(v1), number<Checked>(v2))};
+        case OpKind::less:
+            return ValueSum{number<Checked>(v1) < number<Checked>(v2)};
+        case OpKind::less_equal:
+            return ValueSum{number<Checked>(v1) <= number<Checked>(v2)};
+        case OpKind::greater:
+            return ValueSum{number<Checked>(v1) > number<Checked>(v2)};
+        case OpKind::greater_equal:
+            return ValueSum{number<Checked>(v1) >= number<Checked>(v2)};
+        case OpKind::equal:
+            if (is_number(v1) && is_number(v2))
+                return ValueSum{number_of(v1) == number_of(v2)};
+            if (is_bool(v1) && is_bool(v2))
+                return ValueSum{bool_of(v1) == bool_of(v2)};
+            return ValueSum{false}; // comparing values of different type
+        case OpKind::not_equal:
+            if (is_number(v1) && is_number(v2))
+                return ValueSum{number_of(v1) != number_of(v2)};
+            if (is_bool(v1) && is_bool(v2))
+                return ValueSum{bool_of(v1) != bool_of(v2)};
+            return ValueSum{false}; // comparing values of different type
+        case OpKind::logic_and:
+            return ValueSum{boolean<Checked>(v1) && boolean<Checked>(v2)};
+        case OpKind::logic_xor:
+            return ValueSum{boolean<Checked>(v1) != boolean<Checked>(v2)}; // logical XOR is equivalent to !=
+        case OpKind::logic_or:
+            return ValueSum{boolean<Checked>(v1) || boolean<Checked>(v2)};
+        case OpKind::assign:
+        case OpKind::none:
+            break;
     }
-    return oss.str();
+    return ValueSum{};
 }
 
 // Evaluates the operator along with its sub-expressions and returns the result as a double.
-ValueSum Operator::eval() {
-    if (token.text == "=") {
-        ValueSum value = sub_expr.front()->eval();
+ValueSum Operator::eval(Frame &frame) {
+    if (kind == OpKind::assign) {
+        ValueSum value = sub_expr.front()->eval(frame);
         for (size_t i = 1; i < sub_expr.size(); ++i) {
-            if (sub_expr[i]->token.type != Type::identifier)
+            if (sub_expr[i]->type != Type::identifier)
                 throw RuntimeError("Runtime error: invalid assignee.");
                 // throw UnexpectedToken(sub_expr[i]->token);
-            env->add(sub_expr[i]->to_string(), value);
+            frame.set(assign_slots[i], value);
         }
         return value;
     }
-    std::vector<ValueSum> values;
-    for (auto sub: sub_expr) {
-        values.push_back(sub->eval());
-    }
-    
-    if (values.size() != 2)
+    if (sub_expr.size() != 2)
         throw RuntimeError("Runetime Error: Illegal operation");
-    ValueSum v1 = values[0], v2 = values[1];
-
-    ValueSum ret;
-    if (token.text == "+") 
-        ret = ValueSum{get_number(v1) + get_number(v2)};
-    else if (token.text == "-")
-        ret = ValueSum{get_number(v1) - get_number(v2)};
-    else if (token.text == "*")
-        ret = ValueSum{get_number(v1) * get_number(v2)};
-    else if (token.text == "/") {
-        if (get_number(v2) == 0)
-            throw RuntimeError("Runtime error: division by zero.");
-        ret = ValueSum{get_number(v1) / get_number(v2)};
-    }
-    else if (token.text == "%") {
-        if (get_number(v2) == 0)
-            throw RuntimeError("Runtime error: division by zero.");
-        ret = ValueSum{std::fmod(get_number(v1), get_number(v2))};
-    }
-    else if (token.text == "<")
-        ret = ValueSum{get_number(v1) < get_number(v2)};
-    else if (token.text == "<=") 
-        ret = ValueSum{get_number(v1) <= get_number(v2)};
-    else if (token.text == ">") 
-        ret = ValueSum{get_number(v1) > get_number(v2)};
-    else if (token.text == ">=") 
-        ret = ValueSum{get_number(v1) >= get_number(v2)};
-    else if (token.text == "==") {
-        if (is_number(v1) && is_number(v2))
-            ret = ValueSum{get_number(v1) == get_number(v2)};
-        else if (is_bool(v1) && is_bool(v2))
-            ret = ValueSum{get_bool(v1) == get_bool(v2)};
-        else // comparing values of different type
-            return ValueSum{false};
-    }
-    else if (token.text == "!=") {
-        if (is_number(v1) && is_number(v2))
-            ret = ValueSum{get_number(v1) != get_number(v2)};
-        else if (is_bool(v1) && is_bool(v2))
-            ret = ValueSum{get_bool(v1) != get_bool(v2)};
-        else // comparing values of different type
-            return ValueSum{false};
-    }
-    else if (token.text == "&")
-        ret = ValueSum{get_bool(v1) && get_bool(v2)};
-    else if (token.text == "^")
-        ret = ValueSum{get_bool(v1) != get_bool(v2)}; // logical XOR is equivalent to !=
-    else if (token.text == "|")
-        ret = ValueSum{get_bool(v1) || get_bool(v2)};
-    return ret;
+    ValueSum v1 = sub_expr[0]->eval(frame), v2 = sub_expr[1]->eval(frame);
+    return checked ? apply<true>(kind, v1, v2) : apply<false>(kind, v1, v2);
 }
 
 // Adds a sub-expression to the list of sub-expressions for the operator.
-void Operator::add_sub_expr(std::shared_ptr<ASTNode> expr) { 
+void Operator::add_sub_expr(ASTNode *expr) { 
     sub_expr.push_back(expr);
 }
 
-Block::Block(Token token, std::shared_ptr<Environment> env, bool braced) { 
-    this->token = token;
-    this->env = env;
+BlockKind decode_block(std::string_view text) {
+    if (text == "if")     return BlockKind::if_;
+    if (text == "while")  return BlockKind::while_;
+    if (text == "print")  return BlockKind::print;
+    if (text == "return") return BlockKind::return_;
+    if (text == "else")   return BlockKind::else_;
+    if (text == "__main__") return BlockKind::main;
+    return BlockKind::block;
+}
+
+const char *block_text(BlockKind kind) {
+    static const char *text[] = {
+        "__main__", "__block__", "if", "while", "print", "return", "else"
+    };
+    return text[static_cast<int>(kind)];
+}
+
+Block::Block(Arena &arena, BlockKind kind, bool braced)
+    : statements(arena), functions(arena), kind(kind) { 
+    this->type = Type::statement;
     this->braced = braced; 
 }
-std::string Block::to_string() {
-    std::ostringstream oss;
-    std::shared_ptr<ASTNode> prev = nullptr;
-
-    if (token.text != "__main__" && token.text != "__block__") {
-        if (token.text == "else")
-            oss << "\n";
-        // Print statement token
-        oss << token.text;
-        if (!statements.empty() && statements[0]->to_string() != "__blank__")
-            oss << " ";
-    }
-    for (size_t i = 0; i < statements.size(); ++i) {
-        auto statement = statements[i];
-        // expr -> (expr)
-        if (statement->token.type != Type::statement) {
-            if (statement->to_string() != "__blank__")
-                oss << statement->to_string();
-            if (token.text == "__main__" || token.text == "__block__" || token.text == "else" || token.text == "print" || token.text == "return")
-                oss << ";";
-        }
-        else {
-            if (statement->is_braced()) {
-                // We are in some braced block
-                std::string tab = "    "; // 4 spaces
-                if (prev && prev->token.type != Type::statement)
-                    oss << " ";
-                oss << "{\n";
-
-                // Add tabs
-                std::string block_str = statement->to_string();
-
-                oss << tab;
-                for (size_t ci = 0; ci < block_str.length(); ++ci) {
-                    oss << block_str[ci];
-                    if (block_str[ci] == '\n' && ci != block_str.length() - 1) 
-                        oss << tab;
-                }
-                oss << "\n}";
-            }
-            else {
-                // Some expression
-                oss << statement->to_string();
-            }
-        }
-        prev = statement;
-        if ((token.text == "__main__" || token.text == "__block__") && i != statements.size() - 1)
-            oss << "\n";
-    }
-    return oss.str();
+// Placeholder the parser uses for a missing expression
+static bool is_blank(ASTNode *node) {
+    auto id = dynamic_cast<Identifier *>(node);
+    return id && id->name == "__blank__";
 }
-ValueSum Block::eval() {
-    // Evaluate program AST, log prints into global outputstream
+
+ValueSum Block::eval(Frame &frame) {
+    exec(frame);
+    return ValueSum{false};
+}
+Completion Block::exec(Frame &frame) {
+    // Runs the statements of the block, prints go to the Output of frame.stack
     
-    if (token.text == "__main__" || token.text == "__block__" || token.text == "else") {
+    if (kind == BlockKind::main || kind == BlockKind::block || kind == BlockKind::else_) {
         // We are in some kind of braced block
-        // Evaluate all the statements within
+        // Evaluate all the statements within, stop early on return
+        Profiler *profiler = frame.stack->profiler;
+        // Defs are bound and capture each time they run, the cursor is per activation
+        size_t function_index = 0;
         for (auto statement : statements) {
             // std::cout << statement->to_string() << std::endl;
             // std::cout << "block env:\n" <<  statement->env->to_string() << std::endl;
-            if (statement->token.text == "def") {
+            if (function_index < functions.size() && statement == functions[function_index]) {
                 // statement is a function
-                if (!functions.empty() && function_index < functions.size()) {
-                    env->add(functions[function_index]->name, ValueSum{functions[function_index]});
-                    auto lock = functions[function_index]->fenv_ptr.lock();
-                    if (lock){
-                        lock->copy(env);
-                    }
-                    function_index++;
-                }
+                frame.set(functions[function_index]->slot, functions[function_index]->capture(frame));
+                function_index++;
             }
-            statement->eval();
+            Completion completion = profiler ? profiler->exec(statement, frame) : statement->exec(frame);
+            if (completion != Completion::normal)
+                return completion;
         }
     }
     else {
-        if (token.text == "if") {
+        if (kind == BlockKind::if_) {
             auto cond = statements[0];
             auto body = statements[1];
 
-            if (!is_bool(cond->eval()))
+            ValueSum value = cond->eval(frame);
+            if (checked && !is_bool(value))
                 throw RuntimeError("Runtime error: condition is not a bool.");
-            if (get_bool(cond->eval()))
-                body->eval();
+            if (bool_of(value))
+                return body->exec(frame);
             else if (statements.size() == 3)
-                statements[2]->eval();  // Evaluate else body
+                return statements[2]->exec(frame);  // Evaluate else body
         }
-        else if (token.text == "while") {
+        else if (kind == BlockKind::while_) {
             auto cond = statements[0];
             auto body = statements[1];
 
-            // this eval might have side effects?
-            if (!is_bool(cond->eval()))
-                throw RuntimeError("Runtime error: condition is not a bool.");
-            
-            while (get_bool(cond->eval())) {
-                body->eval();
-                if (!is_bool(cond->eval()))
+            // Once hot, the loop continues in native code from its condition if the Jit can compile it
+            Jit *jit = frame.stack->jit;
+            if (jit && iterations >= Jit::HOT_LOOP && jit->run_loop(this, frame))
+                return Completion::normal;
+            // The condition runs once per iteration, it may have side effects
+            for (;;) {
+                if (jit && ++iterations == Jit::HOT_LOOP && jit->run_loop(this, frame))
+                    return Completion::normal;
+                ValueSum value = cond->eval(frame);
+                if (checked && !is_bool(value))
                     throw RuntimeError("Runtime error: condition is not a bool.");
+                if (!bool_of(value))
+                    break;
+                Completion completion = body->exec(frame);
+                if (completion != Completion::normal)
+                    return completion;
             }
         }
-        else if (token.text == "print") {
+        else if (kind == BlockKind::print) {
             auto body = statements[0];
-            GLOBAL_COUT << vsum_to_string(body->eval()) << '\n';
+            frame.stack->output->write(vsum_to_string(body->eval(frame)));
+            frame.stack->output->put('\n');
         }
-        else if (token.text == "return") {
+        else if (kind == BlockKind::return_) {
             // return; -> nullptr
-            // std::cout << "RETURN called: ";
-            // std::cout << statements.size() << std::endl;
-            // std::cout << "ENV: " << env->to_string() << std::endl;
-            if (statements.empty()) throw ReturnThrow(ValueSum{nullptr});
-            if (statements[0]->token.text == "__blank__") throw ReturnThrow(ValueSum{nullptr});
             // return expr; -> eval(expr)
-            // std::cout << "RETURN called: ";
-            // std::cout << vsum_to_string(statements[0]->eval()) << std::endl;
-            throw ReturnThrow(statements[0]->eval());
+            if (tail_call) {
+                static_cast<Function *>(statements[0])->tail_call(frame);
+                return Completion::tail;
+            }
+            if (statements.empty() || is_blank(statements[0]))
+                frame.result = ValueSum{nullptr};
+            else
+                frame.result = statements[0]->eval(frame);
+            return Completion::ret;
         }
     }
-    return ValueSum{false};
+    return Completion::normal;
 }
-void Block::add_statement(std::shared_ptr<ASTNode> statement) {
+void Block::add_statement(ASTNode *statement) {
     statements.push_back(statement);
 }
-void Block::add_function(std::shared_ptr<Function> function) {
+void Block::add_function(Function *function) {
     functions.push_back(function);
 }
 
@@ -292,73 +294,28 @@ bool Identifier::is_braced()    { return braced; }
 bool Operator::is_braced()      { return braced; }
 bool Function::is_braced()      { return braced; }
 
-Function::Function(Token token, std::shared_ptr<Environment> env, std::string name, bool called) {
-    this->token = token;
-    this->fenv_ptr = env;
-    this->name = name;
-    this->called = called;
+Function::Function(Arena &arena, uint32_t atom, bool called)
+    : call_block(arena), arg_names(arena), arg_atoms(arena), name(Symbols::table().name(atom)), atom(atom),
+      called(called), arg_slots(arena), captures(arena) {
+    this->type = called ? Type::identifier : Type::statement;
 }
 
-std::string Function::to_string() {
-    std::ostringstream oss;
-    // Function decleration
-    // def foo(...) {...}
-    // std::cout << "Func to_string called" << std::endl;
-    if (!called) {
-        // def foo
-        // std::cout << "start Function tostring signature" << std::endl;
-        oss << "def" << " " << name;
-        // (x, y, ..., z)
-        oss << "(";
-        // std::cout << "arg_names " << arg_names.size() << std::endl;
-        for (size_t i = 0; i < arg_names.size() - 1 && !arg_names.empty(); ++i) {
-            oss << arg_names[i] << ", ";
-        }
-        if (arg_names.size() >= 1) oss << arg_names.back();
-        oss << ") ";
-        // Print block
-        oss << "{\n";
-        if (func_block->to_string().empty())
-            oss << "}";
-        else {
-            std::string tab = "    "; // 4 spaces
-            // std::cout << "finish Function tostring signature" << std::endl;
-            std::string block_str = func_block->to_string();
-            oss << tab;
-            for (size_t ci = 0; ci < block_str.length(); ++ci) {
-                oss << block_str[ci];
-                if (block_str[ci] == '\n' && ci != block_str.length() - 1) 
-                    oss << tab;
-            }
-            oss << "\n}";
-        }
-    }
-    // function called: foo(...)
-    else {
-        oss << name << "(";
-        for (size_t i = 0; i < call_block.size() - 1  && !call_block.empty(); ++i) {
-            oss << call_block[i]->to_string() << ", ";
-        }
-        if (call_block.size() >= 1) oss << call_block.back()->to_string();
-        oss << ")";
-    }
-    return oss.str();
-}
 
 
-void Function::add_func_block(std::shared_ptr<ASTNode> f_block) {
+void Function::add_func_block(ASTNode *f_block) {
     this->func_block = f_block;
 }
 
-void Function::add_call_block(std::shared_ptr<ASTNode> c_block) {
+void Function::add_call_block(ASTNode *c_block) {
     this->call_block.push_back(c_block);
 }
 
-void Function::add_arg_names(std::vector<std::string> arg_names) {
-    this->arg_names = arg_names;
+void Function::add_arg(uint32_t atom) {
+    arg_names.push_back(Symbols::table().name(atom));
+    arg_atoms.push_back(atom);
 }
 
-ValueSum Function::eval() {
+ValueSum Function::eval(Frame &frame) {
     // Capture closure if function defined
     // if (!called) {
     //     // std::cout << "ENV before capture:\n" << env->to_string() << std::endl;
@@ -371,43 +328,122 @@ ValueSum Function::eval() {
 
     //  If called, evaluate and get return value
     if (called) {
-        try {
-            // std::cout << "Function called " << name << std::endl;
-            // std::cout << "ENV: " << env->to_string() << std::endl;
-            // Find function definition in environment and add call_block
-            std::shared_ptr<Function> func;
-            auto lock = fenv_ptr.lock();
-            if (lock){
-                if (lock->contains(name) && is_function(lock->get(name))) { 
-                    func = get_function(lock->get(name));
-                }
-                else {
-                    throw RuntimeError("Runtime error: not a function.");
-                }
-                func->call_block.clear();
-                for (auto c_block : call_block)  
-                    func->add_call_block(c_block);
-                // std::cout << "Call blocks added" << std::endl;
-                if (func->call_block.size() != func->arg_names.size())
-                    throw RuntimeError("Runtime error: incorrect argument count.");
-                // Assign arguments with values
-                // This overwrites previous ones
-                for (size_t i = 0; i < func->arg_names.size(); ++i) {
-                    auto lock2 = func->fenv_ptr.lock();
-                    if (lock2)
-                        lock2->add(func->arg_names[i], func->call_block[i]->eval());
-                }
-
-                func->func_block->eval();
-                // std::cout << "Function evaluated" << std::endl;
+        // std::cout << "Function called " << name << std::endl;
+        // Find function definition in the calling frame
+        // Unbound slots and other values are not functions
+        Closure *closure = lookup(frame);
+        Function *func = closure->def;
+        // Every call gets its own activation record, seeded with the captured closure
+        FrameStack &stack = *frame.stack;
+        if (reinterpret_cast<uintptr_t>(__builtin_frame_address(0)) < stack.stack_limit)
+            throw RuntimeError("Runtime error: maximum call depth exceeded.");
+        Frame callee = stack.push(func->closure, closure->values);
+        FrameGuard guard(stack, callee);
+        // Assign arguments with values, evaluated in the caller's frame
+        for (size_t i = 0; i < func->arg_names.size(); ++i)
+            callee.set(func->arg_slots[i], call_block[i]->eval(frame));
+
+        // A tail call replaces the frame that made it, so the loop runs in constant stack
+        for (;;) {
+            Completion completion;
+            if (Profiler *profiler = stack.profiler) {
+                completion = profiler->call(func, callee);
             }
+            else {
+                Jit *jit = stack.jit;
+                ValueSum result;
+                if (jit && func->native && ++func->calls >= Jit::HOT_CALLS && jit->run_function(func, callee, result))
+                    return result;
+                completion = func->func_block->exec(callee);
+            }
+            if (completion == Completion::ret)
+                return callee.result;
+            if (completion != Completion::tail)
+                return ValueSum{nullptr};  // Default return
+
+            closure = stack.tail_callee;
+            func = closure->def;
+            stack.pop(callee);
+            callee = stack.push(func->closure, closure->values);
+            auto &args = stack.tail_args;
+            size_t base = args.size() - func->arg_slots.size();
+            for (size_t i = 0; i < func->arg_slots.size(); ++i)
+                callee.set(func->arg_slots[i], args[base + i]);
+            args.resize(base);
         }
-        catch (ReturnThrow& ret) {
-            // std::cout << "Return value: " << vsum_to_string(ret.get_ret()) << std::endl;
-            return ret.get_ret();
-        }
-        // Default return
-        return ValueSum{nullptr};
     }
     return ValueSum{false};
-}
\ No newline at end of file
+}
+
+Closure *Function::lookup(Frame &frame) {
+    ValueSum value = frame.values[slot];
+    // A call site nearly always calls the function it called last time, which passed the checks
+    if (value.bits == cached.bits)
+        return function_of(value);
+    // Unbound slots and other values are not functions
+    if (!is_function(value))
+        throw RuntimeError("Runtime error: not a function.");
+    Closure *func = function_of(value);
+    if (call_block.size() != func->def->arg_names.size())
+        throw RuntimeError("Runtime error: incorrect argument count.");
+    cached = value;
+    return func;
+}
+
+ValueSum Function::capture(Frame &frame) {
+    Closure *made = frame.stack->closures.make(this, id, closure->values.size(), frame.values, slot,
+                                               captures.data(), captures.size());
+    return ValueSum{made};
+}
+
+void Function::tail_call(Frame &frame) {
+    Closure *func = lookup(frame);
+    // Arguments are evaluated while the returning frame is still there. Calls
+    // in them may make tail calls of their own, which push above these.
+    for (auto arg : call_block) {
+        ValueSum value = arg->eval(frame);
+        frame.stack->tail_args.push_back(value);
+    }
+    frame.stack->tail_callee = func;
+}
+
+Program::Program() {
+    globals = make_environment();
+}
+
+Program::~Program() {}
+
+Environment *Program::make_environment() {
+    environments.push_back(std::make_unique<Environment>());
+    return environments.back().get();
+}
+
+std::string Program::to_string() { return root->to_string(); }
+
+// Lowest address calls of the evaluator may reach: the stack size of the process
+// below the caller, less some room to report the error and for the expressions
+// between two calls
+static uintptr_t native_stack_limit() {
+    const size_t reserve = 256 << 10;
+    size_t size = 8 << 20;
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+        size = limit.rlim_cur;
+    size = size > 2 * reserve ? size - reserve : size / 2;
+    uintptr_t top = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+    return top > size ? top - size : 0;
+}
+
+ValueSum Program::eval(Output &output, Jit *jit, Profiler *profiler) {
+    frames.output = &output;
+    frames.stack_limit = native_stack_limit();
+    frames.jit = jit;
+    frames.profiler = profiler;
+    Frame frame = globals->frame(&frames);
+    // A return outside any function just stops the program
+    if (profiler)
+        profiler->run(root, frame);
+    else
+        root->exec(frame);
+    return ValueSum{false};
+}
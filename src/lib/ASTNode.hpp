@@ -1,107 +1,215 @@
 #pragma once
 
 #include <stdexcept>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <map>
-#include <variant>
-#include <sstream>
 
 #include "Lexer.hpp"  // Needed for Token processing
+#include "Arena.hpp"
 #include "Environment.hpp"
+#include "Frame.hpp"
+#include "Output.hpp"
 #include "ValueSum.hpp"
 
+class Environment;
+class Jit;
+class Profiler;
+
 /**
  * Base class for the nodes of an Abstract Syntax Tree (AST).
  * Each node in the tree represents a part of an expression,
  * which can be a number or an operator. Each node can be
  * converted to a string representation or can be evaluated to produce a result.
+ * Nodes are allocated in the Arena of their Program and refer to each other by raw pointer.
  */
 
-extern std::ostringstream GLOBAL_COUT;
+// How a statement finished. Anything but normal stops the enclosing blocks
+// and is handed up to whoever handles it (break and continue would go here).
+enum class Completion {
+    normal,
+    ret,    // return, the value is in Frame::result
+    tail    // return f(...), the call is left in FrameStack::tail_callee and tail_args
+};
 
 class ASTNode {
 public:
-    virtual std::string to_string() = 0;  // Convert node to string representation
-    virtual ValueSum eval() = 0;
+    virtual std::string to_string();  // Source form of the node, see Printer
+    virtual ValueSum eval(Frame &frame) = 0;  // Evaluate with variables in frame
+    // Run as a statement, the value of expression statements is discarded
+    virtual Completion exec(Frame &frame) { eval(frame); return Completion::normal; }
     virtual bool is_braced() = 0;
-    Token token;  // Token associated with the node
+    Type type;  // Type of the token the node was built from
     bool braced = false;
-    // Stores the "scope" the node is in
-    std::shared_ptr<Environment> env;
+    uint32_t id = 0;  // Index of the node in Program::locations
 };  
 
 // Represents a value in the AST.
 class Value: public ASTNode {
 public:
-    Value(Token token, std::shared_ptr<Environment> env);
+    Value(const Token &token);
+    Value(ValueSum val);  // Constant computed before evaluation
 
     std::string to_string();
-    ValueSum eval() override;
+    ValueSum eval(Frame &frame) override;
     bool is_braced();
 
     ValueSum val;
 };
 class Identifier : public ASTNode {
 public:
-    Identifier(Token token, std::shared_ptr<Environment> env);
+    Identifier(uint32_t atom);
     std::string to_string();
-    ValueSum eval() override;
+    ValueSum eval(Frame &frame) override;
     bool is_braced();
+
+    std::string_view name;  // View of the name in Symbols
+    uint32_t atom;
+    uint32_t slot = 0;  // Frame slot in env, set by Resolver
 };
+
+// Operators decoded from their token text, in order of the original eval chain
+enum class OpKind {
+    add, sub, mul, div, mod,
+    less, less_equal, greater, greater_equal,
+    equal, not_equal,
+    logic_and, logic_xor, logic_or,
+    assign,
+    none
+};
+
+// Maps an operator's text to its kind, OpKind::none if it is not an operator
+OpKind decode_op(std::string_view text);
+const char *op_text(OpKind kind);
+
 /**
  * Represents an operator (like +, -, *, /) in the AST.
  * An operator can have one or more operands (sub-expressions).
  */
 class Operator: public ASTNode {
 public:
-    Operator(Token token, std::shared_ptr<Environment> env);
+    Operator(Arena &arena, OpKind kind, Type type = Type::op);
 
-    std::string to_string();
-    ValueSum eval() override;
+    ValueSum eval(Frame &frame) override;
     bool is_braced();
 
     // Add an operand for this operator
-    void add_sub_expr(std::shared_ptr<ASTNode> expr);
+    void add_sub_expr(ASTNode *expr);
 
 // private:
-    std::vector<std::shared_ptr<ASTNode>> sub_expr;  // Operands for this operator
+    ArenaVector<ASTNode *> sub_expr;  // Operands for this operator
+    ArenaVector<uint32_t> assign_slots;  // Frame slots of assignees, aligned with sub_expr
+    OpKind kind;  // Decoded once from the token text
+    bool checked = true;  // Operand types are checked, cleared when TypeInference proves them
+};
+
+// Statement blocks, __main__ and __block__ are plain statement lists
+enum class BlockKind {
+    main, block, if_, while_, print, return_, else_
 };
 
+BlockKind decode_block(std::string_view text);
+const char *block_text(BlockKind kind);
+
 class Block: public ASTNode {
 public:
-    Block(Token token, std::shared_ptr<Environment> env, bool braced = false);
+    Block(Arena &arena, BlockKind kind, bool braced = false);
 
-    std::string to_string();
-    ValueSum eval() override;
+    ValueSum eval(Frame &frame) override;
+    Completion exec(Frame &frame) override;
 
-    void add_statement(std::shared_ptr<ASTNode> statement);
-    void add_function(std::shared_ptr<Function> function);
+    void add_statement(ASTNode *statement);
+    void add_function(Function *function);
     bool is_braced();
 
-    std::vector<std::shared_ptr<ASTNode>> statements; 
-    std::vector<std::shared_ptr<Function>> functions;
-    size_t function_index = 0;
+    ArenaVector<ASTNode *> statements; 
+    ArenaVector<Function *> functions;
+    bool checked = true;  // Whether an if/while condition may not be a bool
+    bool tail_call = false;  // A return of a call in a function body, set by Resolver
+    uint32_t iterations = 0;  // Of a while, counted while interpreted until it is hot for the Jit
+    BlockKind kind;
 };
 
 class Function : public ASTNode {
     public:
-        Function(Token token, std::shared_ptr<Environment> env, std::string name, bool called = false);
+        Function(Arena &arena, uint32_t atom, bool called = false);
     
-        std::string to_string();
-        ValueSum eval();
+        ValueSum eval(Frame &frame);
         bool is_braced();
-
-        void add_func_block(std::shared_ptr<ASTNode> f_block);
-        void add_call_block(std::shared_ptr<ASTNode> c_block);
-        void add_arg_names(std::vector<std::string> arg_names);
+        // Calls only: the function called in frame, throws if it cannot be called with these arguments
+        Closure *lookup(Frame &frame);
+        // Calls only: sets up this call to be made once the frame has been popped
+        void tail_call(Frame &frame);
+        // Definitions only: the function value of this run of the def, with the
+        // captured variables of frame
+        ValueSum capture(Frame &frame);
+
+        void add_func_block(ASTNode *f_block);
+        void add_call_block(ASTNode *c_block);
+        void add_arg(uint32_t atom);
 
     // private:
-        std::weak_ptr<Environment> fenv_ptr;
-        std::shared_ptr<ASTNode> func_block;
-        std::vector<std::shared_ptr<ASTNode>> call_block;
-        std::vector<std::string> arg_names;
-        std::string name;
+        Environment *closure = nullptr;  // Definitions only: frame layout of the calls, owned by the Program
+        ASTNode *func_block = nullptr;
+        ArenaVector<ASTNode *> call_block;
+        ArenaVector<std::string_view> arg_names;  // Views of the names in Symbols
+        ArenaVector<uint32_t> arg_atoms;
+        std::string_view name;
+        uint32_t atom;
         bool called;
-};
\ No newline at end of file
+        // Set by Resolver: slot of name in the defining (or calling) env
+        // and slots of the arguments in the closure env
+        uint32_t slot = 0;
+        ArenaVector<uint32_t> arg_slots;
+        // Definitions only: (slot in the defining env, slot in closure) of every
+        // name the body or a def nested in it uses, arguments aside, copied into
+        // the Closure of every function value the def makes
+        ArenaVector<std::pair<uint32_t, uint32_t>> captures;
+        uint32_t calls = 0;  // Definitions only: calls so far, compiled by the Jit when hot
+        bool native = true;  // Definitions only: cleared when the Jit could not compile the body
+        // Calls only: inline cache, the value of slot the last call went to.
+        // Rebinding the name changes the value, so it doubles as the version.
+        // Starts as a null function, which no slot can hold.
+        ValueSum cached = ValueSum{static_cast<Closure *>(nullptr)};
+};
+
+struct SourceLocation {
+    int line;
+    int column;
+};
+
+/**
+ * Owns a parsed program: every node lives in one Arena and is released with it,
+ * source locations are kept in a side table indexed by node id,
+ * and the global and closure Environments are owned here too.
+ */
+class Program {
+public:
+    Program();
+    ~Program();
+
+    // Allocates a node in the arena and records where token came from
+    template <typename T, typename... Args>
+    T *make(const Token &token, Args &&... args) {
+        T *node = arena.make<T>(std::forward<Args>(args)...);
+        node->id = locations.size();
+        locations.push_back(SourceLocation{token.line_number, token.column_number});
+        return node;
+    }
+    Environment *make_environment();
+
+    std::string to_string();
+    // Runs the program, print writes to output, hot code is compiled by jit if
+    // given and profiler, if given, times every statement and call
+    ValueSum eval(Output &output, Jit *jit = nullptr, Profiler *profiler = nullptr);
+
+    Arena arena;
+    std::vector<SourceLocation> locations;
+    std::vector<std::unique_ptr<Environment>> environments;
+    FrameStack frames;  // Activation records of function calls
+    Environment *globals;
+    ASTNode *root = nullptr;
+};
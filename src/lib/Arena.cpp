@@ -0,0 +1,41 @@
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+
+#include "Arena.hpp"
+
+Arena::Arena(size_t block_size) : block_size(block_size) {}
+
+Arena::~Arena() {
+    for (char *block : blocks)
+        std::free(block);
+}
+
+void *Arena::allocate(size_t size, size_t align) {
+    size_t pad = (align - reinterpret_cast<uintptr_t>(cursor) % align) % align;
+    if (!cursor || cursor + pad + size > end) {
+        // Oversized requests get a block of their own
+        size_t bytes = std::max(block_size, size + align);
+        char *block = static_cast<char *>(std::malloc(bytes));
+        if (!block)
+            throw std::bad_alloc();
+        blocks.push_back(block);
+        reserved += bytes;
+        cursor = block;
+        end = block + bytes;
+        pad = (align - reinterpret_cast<uintptr_t>(cursor) % align) % align;
+    }
+    void *ptr = cursor + pad;
+    cursor += pad + size;
+    return ptr;
+}
+
+std::string_view Arena::copy(std::string_view text) {
+    char *data = static_cast<char *>(allocate(text.size(), 1));
+    std::memcpy(data, text.data(), text.size());
+    return std::string_view(data, text.size());
+}
+
+size_t Arena::bytes_reserved() const { return reserved; }
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <new>
+
+// Bump allocator. Memory is handed out from large blocks and is only given back
+// when the Arena itself is destroyed, all at once. Destructors of objects made in
+// the arena are never run, so they must not own memory outside of it.
+class Arena {
+    public:
+        Arena(size_t block_size = 64 * 1024);
+        ~Arena();
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+
+        void *allocate(size_t size, size_t align);
+
+        template <typename T, typename... Args>
+        T *make(Args &&... args) {
+            return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        // Copies text into the arena
+        std::string_view copy(std::string_view text);
+
+        // Bytes of all blocks taken from malloc
+        size_t bytes_reserved() const;
+
+    private:
+        std::vector<char *> blocks;
+        char *cursor = nullptr;
+        char *end = nullptr;
+        size_t block_size;
+        size_t reserved = 0;
+};
+
+// Lets standard containers allocate from an Arena, deallocation is a no-op
+template <typename T>
+struct ArenaAllocator {
+    using value_type = T;
+
+    ArenaAllocator(Arena &arena) : arena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(size_t n) { return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T *, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.arena; }
+
+    Arena *arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
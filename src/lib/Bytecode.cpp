@@ -0,0 +1,172 @@
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "Bytecode.hpp"
+#include "ASTNode.hpp"
+#include "ValueSum.hpp"
+
+uint32_t Bytecode::Scope::resolve(const std::string &name) {
+    auto it = slots.find(name);
+    if (it != slots.end())
+        return it->second;
+    uint32_t slot = names.size();
+    names.push_back(name);
+    slots[name] = slot;
+    return slot;
+}
+
+Bytecode::Chunk Bytecode::Compiler::compile(ASTNode *program) {
+    chunk = Chunk();
+    pending.clear();
+    // Global scope
+    chunk.scopes.push_back(Scope());
+    compile_block(program, 0);
+    emit(OpCode::halt);
+
+    // Function bodies are laid out after the main program
+    for (size_t i = 0; i < pending.size(); ++i) {
+        Proto &proto = chunk.protos[pending[i]];
+        proto.entry = chunk.code.size();
+        uint32_t scope = proto.scope;
+        compile_block(proto.node->func_block, scope);
+        emit(OpCode::ret_null);
+    }
+
+    // A def copies its enclosing environment into the closure. Only names the body
+    // (or a nested def) refers to can be observed, so those are the only ones captured.
+    // Nested protos are created after their parent, walking backwards lets them
+    // register their names in the parent scope before the parent is processed.
+    for (size_t p = chunk.protos.size(); p-- > 0;) {
+        Proto &proto = chunk.protos[p];
+        for (uint32_t slot = 0; slot < chunk.scopes[proto.scope].names.size(); ++slot) {
+            std::string name = chunk.scopes[proto.scope].names[slot];
+            proto.captures.push_back({chunk.scopes[proto.parent].resolve(name), slot});
+        }
+    }
+    return std::move(chunk);
+}
+
+void Bytecode::Compiler::compile_block(ASTNode *node, uint32_t scope) {
+    auto func = dynamic_cast<Function *>(node);
+    if (func && !func->called) {
+        compile_def(func, scope);
+        return;
+    }
+    auto block = dynamic_cast<Block *>(node);
+    if (!block) {
+        // Bare expression statement, its value is discarded
+        compile_expr(node, scope);
+        emit(OpCode::pop);
+        return;
+    }
+
+    BlockKind kind = block->kind;
+    if (kind == BlockKind::if_) {
+        compile_expr(block->statements[0], scope);
+        size_t to_else = emit(OpCode::jump_if_false);
+        compile_block(block->statements[1], scope);
+        if (block->statements.size() == 3) {
+            size_t to_end = emit(OpCode::jump);
+            chunk.code[to_else].arg = chunk.code.size();
+            compile_block(block->statements[2], scope);
+            chunk.code[to_end].arg = chunk.code.size();
+        }
+        else
+            chunk.code[to_else].arg = chunk.code.size();
+    }
+    else if (kind == BlockKind::while_) {
+        size_t top = chunk.code.size();
+        compile_expr(block->statements[0], scope);
+        size_t to_end = emit(OpCode::jump_if_false);
+        compile_block(block->statements[1], scope);
+        emit(OpCode::jump, top);
+        chunk.code[to_end].arg = chunk.code.size();
+    }
+    else if (kind == BlockKind::print) {
+        compile_expr(block->statements[0], scope);
+        emit(OpCode::print);
+    }
+    else if (kind == BlockKind::return_) {
+        auto blank = block->statements.empty() ? nullptr : dynamic_cast<Identifier *>(block->statements[0]);
+        if (block->statements.empty() || (blank && blank->name == "__blank__"))
+            emit(OpCode::ret_null);
+        else {
+            compile_expr(block->statements[0], scope);
+            emit(OpCode::ret);
+        }
+    }
+    else {
+        // __main__, __block__ and else hold a list of statements
+        for (auto statement : block->statements)
+            compile_block(statement, scope);
+    }
+}
+
+void Bytecode::Compiler::compile_expr(ASTNode *node, uint32_t scope) {
+    if (auto value = dynamic_cast<Value *>(node)) {
+        emit(OpCode::constant, add_constant(value->val));
+    }
+    else if (auto func = dynamic_cast<Function *>(node)) {
+        CallSite site{chunk.scopes[scope].resolve(std::string(func->name)), (uint32_t)func->call_block.size()};
+        chunk.calls.push_back(site);
+        emit(OpCode::call_begin, chunk.calls.size() - 1);
+        for (size_t i = 0; i < func->call_block.size(); ++i) {
+            compile_expr(func->call_block[i], scope);
+            emit(OpCode::set_arg, i);
+        }
+        emit(OpCode::call);
+    }
+    else if (auto op = dynamic_cast<Operator *>(node)) {
+        if (op->kind == OpKind::assign) {
+            compile_expr(op->sub_expr.front(), scope);
+            for (size_t i = 1; i < op->sub_expr.size(); ++i) {
+                auto assignee = op->sub_expr[i];
+                if (assignee->type != Type::identifier)
+                    emit(OpCode::invalid_assignee);
+                else if (dynamic_cast<Identifier *>(assignee))
+                    emit(OpCode::store, chunk.scopes[scope].resolve(assignee->to_string()));
+                // Assigning to a call binds a name no expression can read back
+            }
+            return;
+        }
+        for (auto sub : op->sub_expr)
+            compile_expr(sub, scope);
+
+        // Binary opcodes are laid out in OpKind order
+        emit(static_cast<OpCode>(static_cast<int>(OpCode::add) + static_cast<int>(op->kind)));
+    }
+    else {
+        // Identifier
+        emit(OpCode::load, chunk.scopes[scope].resolve(std::string(static_cast<Identifier *>(node)->name)));
+    }
+}
+
+void Bytecode::Compiler::compile_def(Function *func, uint32_t scope) {
+    Proto proto;
+    proto.node = func;
+    proto.name = func->name;
+    proto.parent = scope;
+    proto.name_slot = chunk.scopes[scope].resolve(proto.name);
+    proto.scope = chunk.scopes.size();
+    proto.entry = 0;
+    chunk.scopes.push_back(Scope());
+    for (auto arg : func->arg_names)
+        proto.params.push_back(chunk.scopes[proto.scope].resolve(std::string(arg)));
+
+    uint32_t index = chunk.protos.size();
+    chunk.protos.push_back(proto);
+    chunk.proto_index[func] = index;
+    pending.push_back(index);
+    emit(OpCode::def, index);
+}
+
+size_t Bytecode::Compiler::emit(OpCode op, uint32_t arg) {
+    chunk.code.push_back(Instruction{op, arg});
+    return chunk.code.size() - 1;
+}
+
+uint32_t Bytecode::Compiler::add_constant(ValueSum value) {
+    chunk.constants.push_back(value);
+    return chunk.constants.size() - 1;
+}
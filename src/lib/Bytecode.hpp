@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include "ASTNode.hpp"
+#include "ValueSum.hpp"
+
+namespace Bytecode {
+
+enum class OpCode : uint8_t {
+    constant,           // push constants[arg]
+    load,               // push slot arg of the current scope
+    store,              // store top of stack into slot arg (value stays on the stack)
+    pop,
+    // binary operators, in OpKind order
+    add, sub, mul, div, mod,
+    less, less_equal, greater, greater_equal,
+    equal, not_equal,
+    logic_and, logic_xor, logic_or,
+    jump,               // pc = arg
+    jump_if_false,      // pop condition, it must be a bool, jump to arg if false
+    print,
+    def,                // bind protos[arg] in the current scope and capture its closure
+    call_begin,         // resolve the callee of call site arg and push it
+    set_arg,            // pop value into parameter arg of the callee below it
+    call,               // pop callee and enter it
+    ret,                // return top of stack
+    ret_null,           // return null
+    invalid_assignee,   // throw, used for assignments to non identifiers
+    halt
+};
+
+struct Instruction {
+    OpCode op;
+    uint32_t arg;
+};
+
+// Names and storage layout of a single Environment
+struct Scope {
+    std::vector<std::string> names;
+    std::unordered_map<std::string, uint32_t> slots;
+
+    uint32_t resolve(const std::string &name);
+};
+
+// A compiled function definition
+struct Proto {
+    Function *node;                 // AST node, the def of the function values made from it
+    std::string name;
+    uint32_t scope;                 // scope of the body (closure environment)
+    uint32_t parent;                // scope the function is defined in
+    uint32_t name_slot;             // slot of the function name in the parent scope
+    size_t entry;                   // pc of the first instruction of the body
+    std::vector<uint32_t> params;   // parameter slots in the body scope
+    // (parent slot, body slot) pairs copied when the definition is executed
+    std::vector<std::pair<uint32_t, uint32_t>> captures;
+};
+
+struct CallSite {
+    uint32_t name_slot;             // slot of the callee name in the calling scope
+    uint32_t argc;
+};
+
+struct Chunk {
+    std::vector<Instruction> code;
+    std::vector<ValueSum> constants;
+    std::vector<Scope> scopes;      // scopes[0] is the global scope
+    std::vector<Proto> protos;
+    std::vector<CallSite> calls;
+    std::unordered_map<const Function*, uint32_t> proto_index;
+};
+
+// Lowers the Block/Operator/Function tree built by Scrypt::Parser into a linear Chunk
+class Compiler {
+    public:
+        Chunk compile(ASTNode *program);
+
+    private:
+        void compile_block(ASTNode *node, uint32_t scope);
+        void compile_expr(ASTNode *node, uint32_t scope);
+        void compile_def(Function *func, uint32_t scope);
+        size_t emit(OpCode op, uint32_t arg = 0);
+        uint32_t add_constant(ValueSum value);
+
+        Chunk chunk;
+        std::vector<uint32_t> pending;   // protos whose bodies are not compiled yet
+};
+
+}
@@ -0,0 +1,31 @@
+#include <algorithm>
+
+#include "Closure.hpp"
+
+// What slot of the defining frame puts in a closure: the closure itself for
+// the def's own name, the value of the slot, maybe unbound, for the others
+static ValueSum captured(const ValueSum *from, uint32_t slot, uint32_t self_slot, Closure *self) {
+    return slot == self_slot ? ValueSum{self} : from[slot];
+}
+
+Closure *Closures::make(Function *def, uint32_t key, size_t size, const ValueSum *from, uint32_t self_slot,
+                        const std::pair<uint32_t, uint32_t> *captures, size_t count) {
+    if (key >= latest.size())
+        latest.resize(key + 1, nullptr);
+    if (Closure *last = latest[key]) {
+        bool same = true;
+        for (size_t i = 0; i < count && same; ++i)
+            same = last->values[captures[i].second].bits == captured(from, captures[i].first, self_slot, last).bits;
+        if (same)
+            return last;
+    }
+
+    Closure *closure = arena.make<Closure>();
+    closure->def = def;
+    closure->values = static_cast<ValueSum *>(arena.allocate(size * sizeof(ValueSum), alignof(ValueSum)));
+    std::fill(closure->values, closure->values + size, ValueSum::unbound());
+    for (size_t i = 0; i < count; ++i)
+        closure->values[captures[i].second] = captured(from, captures[i].first, self_slot, closure);
+    latest[key] = closure;
+    return closure;
+}
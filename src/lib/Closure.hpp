@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "Arena.hpp"
+#include "ValueSum.hpp"
+
+class Function;
+
+// A function value. Every run of a def makes one with its own copy of the
+// variables it captured, laid out like the frames of its calls, so values made
+// by the same def never see each other's captures.
+struct Closure {
+    Function *def;
+    ValueSum *values;  // Captured slots, the others are ValueSum::unbound()
+};
+
+// Makes the function values of one interpreter and keeps them until it goes
+// away. Closures are never written after they are made, so a run of a def that
+// captures the same values as the previous run of that def gets its closure
+// back: a def in a loop or a hot function does not pile up copies.
+class Closures {
+    public:
+        Closures() = default;
+        Closures(const Closures &) = delete;
+        Closures &operator=(const Closures &) = delete;
+
+        // Function value of def, key tells defs apart and size is the number of
+        // slots of its frames. captures are (slot in from, slot in the closure)
+        // pairs, a capture of self_slot gets the new value itself so the function
+        // can call itself.
+        Closure *make(Function *def, uint32_t key, size_t size, const ValueSum *from, uint32_t self_slot,
+                      const std::pair<uint32_t, uint32_t> *captures, size_t count);
+
+    private:
+        Arena arena;
+        std::vector<Closure *> latest;  // by key, made by the last run of each def
+};
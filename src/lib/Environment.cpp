@@ -7,50 +7,94 @@
 #include "Environment.hpp"
 #include "Exception.hpp"
 #include "ValueSum.hpp"
+#include "Symbols.hpp"
 
 // Environment::Environment() : parent(), env() { 
 //     parent = nullptr; 
 // }
 
-Environment::Environment() : env() {}
+Environment::Environment() : slots(), atoms(), values() {}
 
 Environment::~Environment() {
-    env.clear();
+    clear();
 }
 
 // void Environment::set_parent(std::shared_ptr<Environment> p) {
 //     parent = p;
 // }
 
-void Environment::add(const std::string &symbol, ValueSum value) { env[symbol] = value; }
+uint32_t Environment::resolve(uint32_t atom) {
+    auto [it, added] = slots.try_emplace(atom, atoms.size());
+    if (added) {
+        atoms.push_back(atom);
+        values.push_back(ValueSum::unbound());
+    }
+    return it->second;
+}
+
+uint32_t Environment::resolve(const std::string &symbol) {
+    return resolve(Symbols::table().intern(symbol));
+}
+
+std::string_view Environment::name(uint32_t slot) const {
+    return Symbols::table().name(atoms[slot]);
+}
+
+ValueSum Environment::get(uint32_t slot) {
+    if (!is_bound(values[slot]))
+        throw RuntimeError("Runtime error: unknown identifier " + std::string(name(slot)));
+    return values[slot];
+}
+
+void Environment::set(uint32_t slot, ValueSum value) {
+    values[slot] = value;
+}
+
+bool Environment::contains(uint32_t slot) { return is_bound(values[slot]); }
+
+void Environment::add(const std::string &symbol, ValueSum value) { set(resolve(symbol), value); }
 
 ValueSum Environment::get(const std::string &symbol){
-    if (env.find(symbol) == env.end()) {
+    auto it = slots.find(Symbols::table().intern(symbol));
+    if (it == slots.end() || !is_bound(values[it->second])) {
         // if (parent) parent->get(symbol);
         throw RuntimeError("Runtime error: unknown identifier " + symbol);
     }
-    return env[symbol];
+    return values[it->second];
 }
 
-void Environment::copy(std::shared_ptr<Environment> other) {
-    for (auto [k, v]: other->env) {  
-        add(k, v);
-    }    
+Frame Environment::frame(FrameStack *stack) {
+    return Frame{values.data(), this, stack, values.size()};
 }
 
 void Environment::clear() {
-    env.clear();
+    for (auto &value : values)
+        value = ValueSum::unbound();
+}
+
+void Environment::save(uint32_t slot) {
+    undo.push_back({slot, values[slot]});
 }
 
+void Environment::rollback() {
+    // Newest first, so a slot saved twice ends up with its oldest value
+    for (auto it = undo.rbegin(); it != undo.rend(); ++it)
+        values[it->first] = it->second;
+    undo.clear();
+}
+
+void Environment::commit() { undo.clear(); }
+
 std::string Environment::to_string() {
     std::ostringstream oss;
-    for (auto [k, v]: env) {  
-        oss << k << ": " << vsum_to_string(v) << "\n";
+    for (size_t i = 0; i < atoms.size(); ++i) {
+        if (is_bound(values[i]))
+            oss << name(i) << ": " << vsum_to_string(values[i]) << "\n";
     }
     return oss.str();
 }
 
 bool Environment::contains(const std::string &symbol) {
-    return env.find(symbol) != env.end();
+    auto it = slots.find(Symbols::table().intern(symbol));
+    return it != slots.end() && is_bound(values[it->second]);
 }
-
@@ -1,26 +1,55 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
 #include <unordered_map>
+#include <utility>
 
 #include "ASTNode.hpp"
 #include "ValueSum.hpp"
+#include "Frame.hpp"
 
 
 class Environment;
 
+// Variables live in a flat frame indexed by slot. Slots are handed out by
+// Resolver once per name, evaluation then reads and writes them directly.
+// The name based functions are kept as a (slower) debug view of the frame.
 class Environment{
     public:
         Environment();
         ~Environment();
         // void set_parent(std::shared_ptr<Environment> p);
+
+        // Slot of the name with this atom, a new unbound slot is created for unseen names
+        uint32_t resolve(uint32_t atom);
+        uint32_t resolve(const std::string &symbol);
+        std::string_view name(uint32_t slot) const;
+        ValueSum get(uint32_t slot);
+        void set(uint32_t slot, ValueSum value);
+        bool contains(uint32_t slot);
+
+        // View of the slots as the frame of a running program, valid until
+        // new names are resolved
+        Frame frame(FrameStack *stack);
+
         void add(const std::string &symbol, ValueSum value);
-        void copy(std::shared_ptr<Environment> other);
+        // Unbinds every variable, slots stay valid
         void clear();
+        // Undo log for a calc line: the slots it may assign are saved before it
+        // runs, rollback puts their old values back if it fails, commit keeps the new ones
+        void save(uint32_t slot);
+        void rollback();
+        void commit();
         std::string to_string();
         ValueSum get(const std::string &symbol);
         bool contains(const std::string &symbol);
     // protected:
         // std::shared_ptr<Environment> parent;
-        std::unordered_map<std::string, ValueSum> env;
-};
\ No newline at end of file
+        std::unordered_map<uint32_t, uint32_t> slots;  // by atom
+        std::vector<uint32_t> atoms;  // of every slot
+        std::vector<ValueSum> values;  // ValueSum::unbound() until assigned
+        std::vector<std::pair<uint32_t, ValueSum>> undo;
+};
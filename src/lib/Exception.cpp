@@ -13,16 +13,11 @@ SyntaxError::SyntaxError(size_t line, size_t col) {
 size_t SyntaxError::code() { return 1; }
 
 UnexpectedToken::UnexpectedToken(Token t, size_t offset) {
-    message = "Unexpected token at line " + std::to_string(t.line_number) + " column " + std::to_string(t.column_number - offset) + ": " + t.text;
+    message = "Unexpected token at line " + std::to_string(t.line_number) + " column " + std::to_string(t.column_number - offset) + ": " + std::string(t.text);
 }
 size_t UnexpectedToken::code() { return 2; }
 
 RuntimeError::RuntimeError(std::string error_message) {
     message = error_message;
 }
-size_t RuntimeError::code() { return 3; }
-
-ReturnThrow::ReturnThrow(ValueSum ret) {
-    this->ret = ret;
-}
-ValueSum ReturnThrow::get_ret() { return ret; }
\ No newline at end of file
+size_t RuntimeError::code() { return 3; }
\ No newline at end of file
@@ -35,13 +35,4 @@ class RuntimeError : public ScryptException {
         RuntimeError(std::string error_message);
 
         size_t code();
-};
-
-class ReturnThrow : public std::exception {
-    public:
-        ReturnThrow(ValueSum ret);
-        
-        ValueSum get_ret();
-    protected:
-        ValueSum ret;
 };
\ No newline at end of file
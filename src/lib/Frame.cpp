@@ -0,0 +1,44 @@
+#include <algorithm>
+#include <string>
+
+#include "Frame.hpp"
+#include "Environment.hpp"
+#include "Exception.hpp"
+
+ValueSum Frame::get(uint32_t slot) {
+    if (!is_bound(values[slot]))
+        throw RuntimeError("Runtime error: unknown identifier " + std::string(env->name(slot)));
+    return values[slot];
+}
+
+void Frame::set(uint32_t slot, ValueSum value) {
+    values[slot] = value;
+}
+
+bool Frame::contains(uint32_t slot) { return is_bound(values[slot]); }
+
+FrameStack::FrameStack(size_t block_slots) : block_slots(block_slots) {}
+
+Frame FrameStack::push(Environment *env, const ValueSum *values) {
+    size_t size = env->values.size();
+    // Move on to the next block when the frame does not fit in this one
+    while (current < blocks.size() && blocks[current].top + size > blocks[current].size)
+        ++current;
+    if (current == blocks.size()) {
+        Block block;
+        block.size = std::max(block_slots, size);
+        block.values.reset(new ValueSum[block.size]);
+        block.top = 0;
+        blocks.push_back(std::move(block));
+    }
+    Block &block = blocks[current];
+    Frame frame{block.values.get() + block.top, env, this, size, current, block.top};
+    std::copy(values, values + size, frame.values);
+    block.top += size;
+    return frame;
+}
+
+void FrameStack::pop(const Frame &frame) {
+    blocks[frame.block].top = frame.base;
+    current = frame.block;
+}
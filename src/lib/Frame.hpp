@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "Closure.hpp"
+#include "ValueSum.hpp"
+
+class Environment;
+class FrameStack;
+class Output;
+class Jit;
+class Profiler;
+
+// Activation record: a window of slots laid out like env. The global frame is a
+// view of the global Environment, function calls get theirs from a FrameStack.
+struct Frame {
+    ValueSum *values;     // Unbound slots hold ValueSum::unbound()
+    Environment *env;     // Layout of the slots, gives names for errors and debugging
+    FrameStack *stack;    // Where callees allocate their frames
+    size_t size;          // Number of slots
+    size_t block = 0;     // Position in the stack, used to pop the frame
+    size_t base = 0;
+    ValueSum result = ValueSum{nullptr};  // Set by return
+
+    ValueSum get(uint32_t slot);
+    void set(uint32_t slot, ValueSum value);
+    bool contains(uint32_t slot);
+};
+
+// Contiguous, reusable storage for the frames of active calls. Slots come from
+// large blocks that are kept around once allocated, so a call does not touch the heap.
+class FrameStack {
+    public:
+        FrameStack(size_t block_slots = 64 * 1024);
+
+        // Pushes a frame laid out like env and initialised with values
+        Frame push(Environment *env, const ValueSum *values);
+        // Frames must be popped in reverse order of pushing
+        void pop(const Frame &frame);
+
+        Output *output = nullptr;  // Where print writes, one per interpreter
+        Jit *jit = nullptr;        // Compiles hot loops and functions, none when disabled
+        Profiler *profiler = nullptr;  // Times statements and calls, none when disabled
+        // Call of a return in tail position, made by the caller in place of the
+        // returning frame, its arguments are the last ones in tail_args
+        Closure *tail_callee = nullptr;
+        std::vector<ValueSum> tail_args;
+        Closures closures;  // Function values made by defs
+        // Lowest native stack address a call may start at, set by Program::eval.
+        // The evaluator recurses for every call, deeper calls are an error.
+        uintptr_t stack_limit = 0;
+
+    private:
+        struct Block {
+            std::unique_ptr<ValueSum[]> values;
+            size_t size;
+            size_t top;
+        };
+        std::vector<Block> blocks;
+        size_t current = 0;
+        size_t block_slots;
+};
+
+// Pops a pushed frame when leaving scope, including by exception
+class FrameGuard {
+    public:
+        FrameGuard(FrameStack &stack, const Frame &frame) : stack(stack), frame(frame) {}
+        ~FrameGuard() { stack.pop(frame); }
+
+    private:
+        FrameStack &stack;
+        const Frame &frame;
+};
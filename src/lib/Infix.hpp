@@ -2,7 +2,6 @@
 
 #include <iostream>
 #include <vector>
-#include <deque>
 #include <unordered_map>
 #include <string>
 #include <memory>
@@ -11,21 +10,55 @@
 #include "ASTNode.hpp"
 #include "Environment.hpp"
 
-extern std::unordered_map<std::string, int> PRECEDENCE;
-extern std::unordered_map<std::string, std::string> ASSOCIATIVITY;
+// How tightly an operator holds the operands on either side of it. An operator
+// continues an expression while its left power is at least the current minimum,
+// and parses its right operand with its right power as the new minimum.
+// Left associative operators bind tighter on the right, assignment on the left.
+struct BindingPower {
+    int left;
+    int right;
+};
+
+// Indexed by OpKind
+constexpr BindingPower BINDING_POWER[] = {
+    {19, 20}, {19, 20}, {21, 22}, {21, 22}, {21, 22},   // + - * / %
+    {17, 18}, {17, 18}, {17, 18}, {17, 18},             // < <= > >=
+    {15, 16}, {15, 16},                                 // == !=
+    {13, 14},                                           // &
+    {11, 12},                                           // ^
+    {9, 10},                                            // |
+    {2, 1},                                             // =
+    {-1, -1}                                            // none
+};
 
 namespace Infix {
 
+// Pratt parser, reads an expression in one pass and throws at the first token that
+// does not fit.
 class Parser {
     public:
-        std::shared_ptr<ASTNode> parse(std::deque<Token> &tokens, std::shared_ptr<Environment> env);
-        std::shared_ptr<ASTNode> parse(std::shared_ptr<Environment> env);
-        Parser(std::deque<Token> input);
-        std::pair<int, std::string> eval(std::shared_ptr<Environment> env);
+        // Parses all of tokens as one expression
+        ASTNode *parse(TokenSpan tokens);
+        ASTNode *parse();
+        // Nodes are allocated in program, or in a Program owned by the parser if none is given
+        Parser(TokenSpan input, Program *program = nullptr);
+        // Evaluates a parsed expression in env, returns <error code, value or error message>
+        std::pair<int, std::string> eval(ASTNode *ast, std::shared_ptr<Environment> env);
         std::string to_string();
 
     // private:
-        std::deque<Token> input;
+        // Expression made of operators with a left power of at least min_power
+        ASTNode *parse_expr(int min_power);
+        // Value, variable, call or parenthesised expression
+        ASTNode *parse_operand();
+        // Steps over the next token, which must be of the given type
+        void expect(Type type);
+
+        TokenSpan input;
+        TokenSpan tokens;   // Being parsed
+        size_t pos = 0;
+        std::shared_ptr<Program> owned;
+        Program *program;
 };
 
 
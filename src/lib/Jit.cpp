@@ -0,0 +1,439 @@
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define SCRYPT_JIT 1
+#endif
+
+#include "Jit.hpp"
+#include "ASTNode.hpp"
+#include "Exception.hpp"
+
+// What compiled code returns
+enum Status { FELL_THROUGH = 0, RETURNED = 1, DIVISION_BY_ZERO = 2 };
+
+// Slots read or assigned by node, function bodies are not entered
+static void used_slots(ASTNode *node, std::vector<uint32_t> &slots) {
+    if (auto id = dynamic_cast<Identifier *>(node))
+        slots.push_back(id->slot);
+    else if (auto op = dynamic_cast<Operator *>(node)) {
+        if (op->kind == OpKind::assign)
+            for (size_t i = 1; i < op->sub_expr.size(); ++i)
+                slots.push_back(op->assign_slots[i]);
+        for (auto sub : op->sub_expr)
+            used_slots(sub, slots);
+    }
+    else if (auto block = dynamic_cast<Block *>(node))
+        for (auto statement : block->statements)
+            used_slots(statement, slots);
+}
+
+// Emits machine code for a node while following the kinds of the slots, the
+// same way TypeInference does. Anything it cannot prove fails the compilation.
+// Slots are addressed off rbx, the result pointer is in r12. Expressions leave
+// numbers in xmm0 and bools as 0/1 in eax, operands wait on the machine stack
+// in 16 byte cells so calls to fmod stay aligned.
+class Jit::Emitter {
+    public:
+        using Kinds = std::unordered_map<uint32_t, Kind>;
+
+        explicit Emitter(bool function) : function(function) {}
+
+        bool compile(ASTNode *node, Kinds &kinds) {
+            // push rbp; mov rbp, rsp; push rbx; push r12; mov rbx, rdi; mov r12, rsi
+            bytes({0x55, 0x48, 0x89, 0xe5, 0x53, 0x41, 0x54, 0x48, 0x89, 0xfb, 0x49, 0x89, 0xf4});
+            if (!statement(node, kinds))
+                return false;
+            leave(FELL_THROUGH);
+            return true;
+        }
+
+        std::vector<uint8_t> code;
+
+    private:
+        static constexpr size_t MAX_LOOP_DEPTH = 6;
+
+        void bytes(std::initializer_list<uint8_t> list) { code.insert(code.end(), list); }
+        void imm32(uint32_t value) {
+            for (int i = 0; i < 4; ++i) code.push_back(value >> (8 * i));
+        }
+        void imm64(uint64_t value) {
+            for (int i = 0; i < 8; ++i) code.push_back(value >> (8 * i));
+        }
+        // Jump with a rel32 to patch, returns where the offset goes
+        size_t jump(std::initializer_list<uint8_t> opcode) {
+            bytes(opcode);
+            imm32(0);
+            return code.size() - 4;
+        }
+        void patch(size_t at, size_t target) {
+            uint32_t rel = target - (at + 4);
+            std::memcpy(&code[at], &rel, 4);
+        }
+        void jump_to(size_t target) {
+            size_t at = jump({0xe9});
+            patch(at, target);
+        }
+        // mov eax, status; lea rsp, [rbp-16]; pop r12; pop rbx; pop rbp; ret
+        void leave(Status status) {
+            bytes({0xb8}); imm32(status);
+            bytes({0x48, 0x8d, 0x65, 0xf0, 0x41, 0x5c, 0x5b, 0x5d, 0xc3});
+        }
+        void load(uint32_t slot, Kind kind) {
+            if (kind == Kind::number)
+                bytes({0xf2, 0x0f, 0x10, 0x83});        // movsd xmm0, [rbx+disp]
+            else
+                bytes({0x48, 0x8b, 0x83});              // mov rax, [rbx+disp]
+            imm32(8 * slot);
+            if (kind == Kind::boolean)
+                bytes({0x83, 0xe0, 0x01});              // and eax, 1, true is odd
+        }
+        // Boxes a bool in eax into rcx
+        void box_bool() {
+            bytes({0x48, 0xb9}); imm64(ValueSum::FALSE_BITS);   // mov rcx, false
+            bytes({0x48, 0x09, 0xc1});                          // or rcx, rax
+        }
+        void store(uint32_t slot, Kind kind) {
+            if (kind == Kind::number)
+                bytes({0xf2, 0x0f, 0x11, 0x83});        // movsd [rbx+disp], xmm0
+            else {
+                box_bool();
+                bytes({0x48, 0x89, 0x8b});              // mov [rbx+disp], rcx
+            }
+            imm32(8 * slot);
+        }
+        void push(Kind kind) {
+            bytes({0x48, 0x83, 0xec, 0x10});            // sub rsp, 16
+            if (kind == Kind::number)
+                bytes({0xf2, 0x0f, 0x11, 0x04, 0x24});  // movsd [rsp], xmm0
+            else
+                bytes({0x48, 0x89, 0x04, 0x24});        // mov [rsp], rax
+        }
+        // Right operand to xmm1/ecx, left operand back to xmm0/eax
+        void pop(Kind left, Kind right) {
+            if (right == Kind::number)
+                bytes({0x66, 0x0f, 0x28, 0xc8});        // movapd xmm1, xmm0
+            else
+                bytes({0x89, 0xc1});                    // mov ecx, eax
+            if (left == Kind::number)
+                bytes({0xf2, 0x0f, 0x10, 0x04, 0x24});  // movsd xmm0, [rsp]
+            else
+                bytes({0x48, 0x8b, 0x04, 0x24});        // mov rax, [rsp]
+            bytes({0x48, 0x83, 0xc4, 0x10});            // add rsp, 16
+        }
+        // Leaves with DIVISION_BY_ZERO when xmm1 is zero, NaN is not
+        void check_divisor() {
+            bytes({0x66, 0x0f, 0x57, 0xd2});            // xorpd xmm2, xmm2
+            bytes({0x66, 0x0f, 0x2e, 0xca});            // ucomisd xmm1, xmm2
+            size_t unordered = jump({0x0f, 0x8a});      // jp
+            size_t nonzero = jump({0x0f, 0x85});        // jne
+            leave(DIVISION_BY_ZERO);
+            patch(unordered, code.size());
+            patch(nonzero, code.size());
+        }
+        // setcc al (and a second flag into cl), then zero extend into eax
+        void set(uint8_t cc, uint8_t combine = 0, uint8_t cc2 = 0) {
+            bytes({0x0f, cc, 0xc0});
+            if (combine) {
+                bytes({0x0f, cc2, 0xc1});
+                bytes({combine, 0xc8});                 // and/or al, cl
+            }
+            bytes({0x0f, 0xb6, 0xc0});                  // movzx eax, al
+        }
+
+        Kind expr(ASTNode *node, Kinds &kinds) {
+            if (auto value = dynamic_cast<Value *>(node)) {
+                if (is_number(value->val)) {
+                    bytes({0x48, 0xb8}); imm64(value->val.bits);    // mov rax, imm64
+                    bytes({0x66, 0x48, 0x0f, 0x6e, 0xc0});          // movq xmm0, rax
+                    return Kind::number;
+                }
+                if (is_bool(value->val)) {
+                    bytes({0xb8}); imm32(bool_of(value->val));       // mov eax, imm32
+                    return Kind::boolean;
+                }
+                return Kind::unknown;
+            }
+            if (auto id = dynamic_cast<Identifier *>(node)) {
+                // Unbound and non numeric slots are not in kinds
+                auto it = kinds.find(id->slot);
+                if (it == kinds.end())
+                    return Kind::unknown;
+                load(id->slot, it->second);
+                return it->second;
+            }
+            auto op = dynamic_cast<Operator *>(node);
+            if (!op)
+                return Kind::unknown;
+
+            if (op->kind == OpKind::assign) {
+                Kind kind = expr(op->sub_expr[0], kinds);
+                if (kind == Kind::unknown)
+                    return kind;
+                for (size_t i = 1; i < op->sub_expr.size(); ++i) {
+                    if (!dynamic_cast<Identifier *>(op->sub_expr[i]))
+                        return Kind::unknown;
+                    store(op->assign_slots[i], kind);
+                    kinds[op->assign_slots[i]] = kind;
+                }
+                return kind;
+            }
+            if (op->sub_expr.size() != 2)
+                return Kind::unknown;
+            Kind left = expr(op->sub_expr[0], kinds);
+            if (left == Kind::unknown)
+                return left;
+            push(left);
+            Kind right = expr(op->sub_expr[1], kinds);
+            if (right == Kind::unknown)
+                return right;
+            pop(left, right);
+
+            bool numbers = left == Kind::number && right == Kind::number;
+            bool bools = left == Kind::boolean && right == Kind::boolean;
+            switch (op->kind) {
+                case OpKind::add: if (!numbers) break; bytes({0xf2, 0x0f, 0x58, 0xc1}); return Kind::number;
+                case OpKind::sub: if (!numbers) break; bytes({0xf2, 0x0f, 0x5c, 0xc1}); return Kind::number;
+                case OpKind::mul: if (!numbers) break; bytes({0xf2, 0x0f, 0x59, 0xc1}); return Kind::number;
+                case OpKind::div:
+                    if (!numbers) break;
+                    check_divisor();
+                    bytes({0xf2, 0x0f, 0x5e, 0xc1});    // divsd xmm0, xmm1
+                    return Kind::number;
+                case OpKind::mod: {
+                    if (!numbers) break;
+                    check_divisor();
+                    double (*fmod)(double, double) = std::fmod;
+                    bytes({0x48, 0xb8}); imm64(reinterpret_cast<uintptr_t>(fmod));
+                    bytes({0xff, 0xd0});                // call rax
+                    return Kind::number;
+                }
+                // a < b as b > a, so that NaN compares false
+                case OpKind::less:          if (!numbers) break; bytes({0x66, 0x0f, 0x2e, 0xc8}); set(0x97); return Kind::boolean;
+                case OpKind::less_equal:    if (!numbers) break; bytes({0x66, 0x0f, 0x2e, 0xc8}); set(0x93); return Kind::boolean;
+                case OpKind::greater:       if (!numbers) break; bytes({0x66, 0x0f, 0x2e, 0xc1}); set(0x97); return Kind::boolean;
+                case OpKind::greater_equal: if (!numbers) break; bytes({0x66, 0x0f, 0x2e, 0xc1}); set(0x93); return Kind::boolean;
+                case OpKind::equal:
+                case OpKind::not_equal: {
+                    bool equal = op->kind == OpKind::equal;
+                    if (numbers) {
+                        bytes({0x66, 0x0f, 0x2e, 0xc1});    // ucomisd xmm0, xmm1
+                        // equal: ZF and not PF, not equal: not ZF or PF
+                        equal ? set(0x94, 0x20, 0x9b) : set(0x95, 0x08, 0x9a);
+                    }
+                    else if (bools) {
+                        bytes({0x39, 0xc8});                // cmp eax, ecx
+                        set(equal ? 0x94 : 0x95);
+                    }
+                    else {
+                        // comparing values of different type
+                        bytes({0xb8}); imm32(0);
+                    }
+                    return Kind::boolean;
+                }
+                case OpKind::logic_and: if (!bools) break; bytes({0x21, 0xc8}); return Kind::boolean;
+                case OpKind::logic_xor: if (!bools) break; bytes({0x31, 0xc8}); return Kind::boolean;
+                case OpKind::logic_or:  if (!bools) break; bytes({0x09, 0xc8}); return Kind::boolean;
+                case OpKind::assign:
+                case OpKind::none:
+                    break;
+            }
+            return Kind::unknown;
+        }
+
+        // Keeps in into only what it agrees on with other
+        static void join(Kinds &into, const Kinds &other) {
+            for (auto it = into.begin(); it != into.end();) {
+                auto match = other.find(it->first);
+                if (match != other.end() && match->second == it->second)
+                    ++it;
+                else
+                    it = into.erase(it);
+            }
+        }
+
+        bool statement(ASTNode *node, Kinds &kinds) {
+            auto block = dynamic_cast<Block *>(node);
+            if (!block)
+                // Calls and defs are not Operators, expr turns them down
+                return expr(node, kinds) != Kind::unknown;
+
+            auto &statements = block->statements;
+            switch (block->kind) {
+                case BlockKind::main:
+                case BlockKind::block:
+                case BlockKind::else_:
+                    for (auto statement : statements)
+                        if (!this->statement(statement, kinds))
+                            return false;
+                    return true;
+                case BlockKind::if_: {
+                    if (expr(statements[0], kinds) != Kind::boolean)
+                        return false;
+                    bytes({0x85, 0xc0});                    // test eax, eax
+                    size_t to_else = jump({0x0f, 0x84});    // jz
+                    Kinds taken = kinds;
+                    if (!this->statement(statements[1], taken))
+                        return false;
+                    if (statements.size() == 3) {
+                        size_t to_end = jump({0xe9});
+                        patch(to_else, code.size());
+                        if (!this->statement(statements[2], kinds))
+                            return false;
+                        patch(to_end, code.size());
+                    }
+                    else
+                        patch(to_else, code.size());
+                    join(kinds, taken);
+                    return true;
+                }
+                case BlockKind::while_: {
+                    if (++depth > MAX_LOOP_DEPTH)
+                        return false;
+                    // Narrow the kinds at the head of the loop until an iteration keeps them,
+                    // the code of these tries is thrown away
+                    for (;;) {
+                        size_t mark = code.size();
+                        Kinds state = kinds;
+                        bool ok = expr(statements[0], state) == Kind::boolean && this->statement(statements[1], state);
+                        code.resize(mark);
+                        if (!ok)
+                            return false;
+                        Kinds head = kinds;
+                        join(head, state);
+                        if (head.size() == kinds.size())
+                            break;
+                        kinds = head;
+                    }
+                    size_t top = code.size();
+                    expr(statements[0], kinds);
+                    bytes({0x85, 0xc0});                    // test eax, eax
+                    size_t to_end = jump({0x0f, 0x84});     // jz
+                    Kinds body = kinds;
+                    this->statement(statements[1], body);
+                    jump_to(top);
+                    patch(to_end, code.size());
+                    --depth;
+                    return true;
+                }
+                case BlockKind::return_: {
+                    if (!function)
+                        return false;
+                    auto blank = statements.empty() ? nullptr : dynamic_cast<Identifier *>(statements[0]);
+                    if (statements.empty() || (blank && blank->name == "__blank__")) {
+                        bytes({0x48, 0xb9}); imm64(ValueSum::NULL_BITS);    // mov rcx, null
+                        bytes({0x49, 0x89, 0x0c, 0x24});                    // mov [r12], rcx
+                    }
+                    else {
+                        Kind kind = expr(statements[0], kinds);
+                        if (kind == Kind::unknown)
+                            return false;
+                        if (kind == Kind::number)
+                            bytes({0xf2, 0x41, 0x0f, 0x11, 0x04, 0x24});    // movsd [r12], xmm0
+                        else {
+                            box_bool();
+                            bytes({0x49, 0x89, 0x0c, 0x24});                // mov [r12], rcx
+                        }
+                    }
+                    leave(RETURNED);
+                    return true;
+                }
+                case BlockKind::print:
+                    return false;
+            }
+            return false;
+        }
+
+        bool function;      // compiling a function body, return is allowed
+        size_t depth = 0;   // of nested loops
+};
+
+Jit::~Jit() {
+#ifdef SCRYPT_JIT
+    for (auto [page, size] : pages)
+        munmap(page, size);
+#endif
+}
+
+Jit::Kind Jit::kind_of(const ValueSum &val) {
+    if (is_number(val)) return Kind::number;
+    if (is_bool(val))   return Kind::boolean;
+    return Kind::unknown;
+}
+
+Jit::Entry &Jit::entry(ASTNode *node, Frame &frame, bool function) {
+    auto found = entries.find(node);
+    if (found != entries.end())
+        return found->second;
+    Entry &entry = entries[node];
+#ifdef SCRYPT_JIT
+    std::vector<uint32_t> slots;
+    used_slots(node, slots);
+    Emitter::Kinds kinds;
+    for (auto slot : slots) {
+        Kind kind = kind_of(frame.values[slot]);
+        if (kinds.emplace(slot, kind).second)
+            entry.guards.push_back({slot, kind});
+    }
+    for (auto it = kinds.begin(); it != kinds.end();)
+        it = it->second == Kind::unknown ? kinds.erase(it) : std::next(it);
+
+    Emitter emitter(function);
+    if (!emitter.compile(node, kinds))
+        return entry;
+    // Copied into fresh pages that are then made executable
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t size = (emitter.code.size() + page_size - 1) / page_size * page_size;
+    void *page = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (page == MAP_FAILED)
+        return entry;
+    std::memcpy(page, emitter.code.data(), emitter.code.size());
+    if (mprotect(page, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(page, size);
+        return entry;
+    }
+    pages.push_back({page, size});
+    entry.code = reinterpret_cast<Code>(page);
+#else
+    (void)frame;
+    (void)function;
+#endif
+    return entry;
+}
+
+bool Jit::run_loop(Block *loop, Frame &frame) {
+    Entry &entry = this->entry(loop, frame, false);
+    if (!entry.code)
+        return false;
+    for (auto [slot, kind] : entry.guards)
+        if (kind_of(frame.values[slot]) != kind)
+            return false;
+    if (entry.code(frame.values, nullptr) == DIVISION_BY_ZERO)
+        throw RuntimeError("Runtime error: division by zero.");
+    return true;
+}
+
+bool Jit::run_function(Function *func, Frame &frame, ValueSum &result) {
+    Entry &entry = this->entry(func->func_block, frame, true);
+    if (!entry.code) {
+        // Callers stop asking, instead of looking the entry up on every call
+        func->native = false;
+        return false;
+    }
+    for (auto [slot, kind] : entry.guards)
+        if (kind_of(frame.values[slot]) != kind)
+            return false;
+    switch (entry.code(frame.values, &result)) {
+        case DIVISION_BY_ZERO:
+            throw RuntimeError("Runtime error: division by zero.");
+        case FELL_THROUGH:
+            result = ValueSum{nullptr};
+            break;
+    }
+    return true;
+}
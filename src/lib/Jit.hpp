@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ASTNode.hpp"
+#include "Frame.hpp"
+#include "ValueSum.hpp"
+
+// Baseline JIT for the tree-walking evaluator, x86-64 Linux only.
+// Hot while loops and function bodies that only compute with numbers and bools
+// (operators, assignments, if/else, while, return) are compiled to native code
+// working on the frame's slots directly. The kinds of the slots on entry decide
+// the code: an operator it cannot prove the operand types of, a print, a call
+// or a def leaves the node to the interpreter. Code only runs when the frame
+// holds the kinds it was compiled for.
+class Jit {
+    public:
+        static constexpr uint32_t HOT_LOOP = 1000;   // iterations before a loop is compiled
+        static constexpr uint32_t HOT_CALLS = 100;   // calls before a function is compiled
+
+        Jit() = default;
+        ~Jit();
+        Jit(const Jit &) = delete;
+        Jit &operator=(const Jit &) = delete;
+
+        // Runs loop from its condition to its exit, false if it has to be interpreted
+        bool run_loop(Block *loop, Frame &frame);
+        // Runs the body of func in its frame and sets result, false as above
+        bool run_function(Function *func, Frame &frame, ValueSum &result);
+
+    private:
+        enum class Kind : uint8_t { unknown, number, boolean };
+        // Returns one of the statuses in Jit.cpp, result is only written by return
+        using Code = int (*)(ValueSum *slots, ValueSum *result);
+        struct Entry {
+            Code code = nullptr;  // nullptr when the node cannot be compiled
+            std::vector<std::pair<uint32_t, Kind>> guards;  // slot kinds the code was compiled for
+        };
+
+        class Emitter;  // x86-64 code generator, in Jit.cpp
+
+        Entry &entry(ASTNode *node, Frame &frame, bool function);
+        static Kind kind_of(const ValueSum &val);
+
+        std::unordered_map<ASTNode *, Entry> entries;
+        std::vector<std::pair<void *, size_t>> pages;  // executable mappings
+};
@@ -9,15 +9,31 @@
 #include "Lexer.hpp"
 #include "Exception.hpp"
 
-std::deque<Token> Lexer::tokenize(std::istream &stream, int offset) {
-    // Characters considered one at a time from stream
-    std::deque<Token> tokens;
+TokenStream Lexer::tokenize(std::string_view source) {
+    // Characters considered one at a time from source
+    TokenStream tokens(source);
 
-    int line = 1, col = 1 - offset;
-    std::string num;
+    int line = 1, col = 1;
+    const char *p = source.data(), *end = source.data() + source.size();
+    // Accumulated number, normally a view of source
+    std::string_view num;
+    std::string split;
     
     char c;
 
+    // Lambda function to append the digit or '.' at digit to the number accumulator
+    auto add_to_num = [&](const char *digit) {
+        if (split.empty() && (num.empty() || num.data() + num.size() == digit)) {
+            num = std::string_view(num.empty() ? digit : num.data(), num.size() + 1);
+            return;
+        }
+        // Not contiguous with the previous digits, collect a copy
+        if (split.empty())
+            split = num;
+        split += *digit;
+        num = split;
+    };
+
     // Lambda function to finalize the accumulated number token and reset the accumulator
     auto flush_num = [&]() {
         if (num.empty()) return;
@@ -25,41 +41,41 @@ std::deque<Token> Lexer::tokenize(std::istream &stream, int offset) {
         if (num.back() == '.') 
             throw SyntaxError(line, col + num.length());
         
-        // Add the accumulated number as a new token to the tokens deque
-        tokens.push_back(Token{num, line, col, Type::number});
+        // Add the accumulated number as a new token to the token stream
+        tokens.push(Type::number, num, line, col);
         
         // Update column index
         col += num.length();
 
         // Reset the accumulator
-        num.clear();
+        num = std::string_view();
+        split.clear();
     };
 
-    // Loop until end of the stream
-    while (!stream.eof()) {
-        // Read the next character from the stream without skipping white spaces
-        stream >> std::noskipws >> c;
-        if (stream.eof()) break;
+    // Loop until end of the source
+    while (p < end) {
+        // Read the next character, white spaces included
+        c = *p++;
 
         // Create token based on the character read
         if (c == '(') {
             flush_num();  // Flush any accumulated number
-            tokens.push_back(Token{"(", line, col, Type::left_paren});
+            tokens.push(Type::left_paren, std::string_view(p - 1, 1), line, col);
             col++;
         }
         else if (c == ')') {
             flush_num();
-            tokens.push_back(Token{")", line, col, Type::right_paren});
+            tokens.push(Type::right_paren, std::string_view(p - 1, 1), line, col);
             col++;
         }
         else if (c == '{') {
             flush_num();
-            tokens.push_back(Token{"{", line, col, Type::left_curly});
+            tokens.push(Type::left_curly, std::string_view(p - 1, 1), line, col);
             col++;  
         }
         else if (c == '}') {
             flush_num();
-            tokens.push_back(Token{"}", line, col, Type::right_curly});
+            tokens.push(Type::right_curly, std::string_view(p - 1, 1), line, col);
             col++;  
         }
         else if (c == '\n') {
@@ -67,13 +83,13 @@ std::deque<Token> Lexer::tokenize(std::istream &stream, int offset) {
             line++;  // Move to next line
             col = 1;  // Reset column index
         }
-        else if (isspace(c)) {
+        else if (isspace(static_cast<unsigned char>(c))) {
             flush_num();
             col++;  // Move to next column
         }
         else if ('0' <= c && c <= '9') {
             // Append the digit to the number accumulator
-            num += c;
+            add_to_num(p - 1);
         }
         else if (c == '.') {
             // Check for errors like '.' without leading digits or multiple '.' in a number
@@ -82,69 +98,62 @@ std::deque<Token> Lexer::tokenize(std::istream &stream, int offset) {
             else if (std::count(num.begin(), num.end(), '.') == 1)
                 throw SyntaxError(line, col + num.length());
             else
-                num += c;  // Append '.' to the number accumulator
+                add_to_num(p - 1);  // Append '.' to the number accumulator
         }
         else if (c == '+' || c == '-' || c == '*' || c == '/' || c == '%' || c == '&' || c == '^' || c == '|') {
             flush_num();  // Flush any accumulated number
-            tokens.push_back(Token{std::string(1, c), line, col, Type::op});  // Add operator as a new token
+            tokens.push(Type::op, std::string_view(p - 1, 1), line, col);  // Add operator as a new token
             col++;
         }
         else if (c == '<' || c == '>') {
             flush_num();
-            std::string t = std::string(1, c);
-            if (stream.peek() == '=') {
-                stream >> c;
-                t += c;
-            }
-            tokens.push_back(Token{t, line, col, Type::op});
+            std::string_view t(p - 1, 1);
+            if (p < end && *p == '=')
+                t = std::string_view(p++ - 1, 2);
+            tokens.push(Type::op, t, line, col);
             col += t.length();
         }
-        else if (isalpha(c) || c == '_') {
-            std::string identifier;
-            identifier += c;
-            while (stream.peek() == '_' || isalnum(stream.peek())) {
-                stream >> c;
-                identifier += c;
-            }
+        else if (isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            const char *start = p - 1;
+            while (p < end && (*p == '_' || isalnum(static_cast<unsigned char>(*p))))
+                ++p;
+            std::string_view identifier(start, p - start);
             // Reserved words
             if (identifier == "true" || identifier == "false")
-                tokens.push_back(Token{identifier, line, col, Type::boolean});
+                tokens.push(Type::boolean, identifier, line, col);
             else if (identifier == "null")
-                tokens.push_back(Token{identifier, line, col, Type::null});
+                tokens.push(Type::null, identifier, line, col);
             else if (identifier == "while" || identifier == "print" || identifier == "if" || identifier == "else" || identifier == "return" || identifier == "def")
-                tokens.push_back(Token{identifier, line, col, Type::statement});
+                tokens.push(Type::statement, identifier, line, col);
             else
-                tokens.push_back(Token{identifier, line, col, Type::identifier});
+                tokens.push(Type::identifier, identifier, line, col);
             col += identifier.length();
         }
         else if (c == '=') {
             flush_num();
-            std::string t = std::string(1, c);
-            if (stream.peek() == '=') {
-                stream >> c;
-                t += c;
-                tokens.push_back(Token{t, line, col, Type::op});
+            std::string_view t(p - 1, 1);
+            if (p < end && *p == '=') {
+                t = std::string_view(p++ - 1, 2);
+                tokens.push(Type::op, t, line, col);
             }
             else
-                tokens.push_back(Token{"=", line, col, Type::assignment});
+                tokens.push(Type::assignment, t, line, col);
             col += t.length();
         }
-        else if (c == '!' && stream.peek() == '=') {
+        else if (c == '!' && p < end && *p == '=') {
             flush_num();
-            std::string t = std::string(1, c);
-            stream >> c;
-            t += c;
-            tokens.push_back(Token{t, line, col, Type::op});
+            std::string_view t(p++ - 1, 2);
+            tokens.push(Type::op, t, line, col);
             col += t.length();
         }
         else if (c == ',') {
             flush_num();
-            tokens.push_back(Token{",", line, col, Type::comma});
+            tokens.push(Type::comma, std::string_view(p - 1, 1), line, col);
             col++;
         }
         else if (c == ';') {
             flush_num();
-            tokens.push_back(Token{";", line, col, Type::semi_colon});
+            tokens.push(Type::semi_colon, std::string_view(p - 1, 1), line, col);
             col++;
         }
         else {
@@ -155,7 +164,7 @@ std::deque<Token> Lexer::tokenize(std::istream &stream, int offset) {
     flush_num();  // Flush any remaining accumulated number
 
     // Add an "END" token to signify the end of the tokens
-    tokens.push_back(Token{"END", line, col, Type::END});
+    tokens.push(Type::END, "END", line, col);
 
     // Return the generated tokens
     return tokens;
@@ -2,40 +2,19 @@
 
 #include <iostream>
 #include <string>
-#include <deque>
+#include <string_view>
 
-enum class Type {
-    left_paren,    
-    right_paren,
-    left_curly,
-    right_curly,
-    comma,
-    semi_colon,
-    boolean,
-    statement,
-    null,
-    number,        
-    op,    
-    identifier,
-    assignment,        
-    END            
-};
-
-struct Token {
-    std::string text;
-    int line_number;
-    int column_number;
-    Type type;
-};
+#include "Token.hpp"
 
 // The Lexer class is responsible for converting an input stream into individual tokens.
-// It uses the Token structure to represent each token and a deque container to store the sequence of tokens.
+// The sequence of tokens is stored in a TokenStream.
 class Lexer {
     public:
         Lexer() = default;
 
-        // This function tokenizes the provided input stream and returns a deque of Tokens.
+        // This function tokenizes the provided source text and returns its TokenStream.
         // The tokenizing process involves identifying different types of characters and sequences 
         // and classifying them into categories like parentheses, numbers, operators, etc.
-        std::deque<Token> tokenize(std::istream &stream, int offset = 0);
+        // Token texts point into source, which must outlive them.
+        TokenStream tokenize(std::string_view source);
 };
@@ -0,0 +1,145 @@
+#include <vector>
+
+#include "Optimizer.hpp"
+#include "ASTNode.hpp"
+#include "Exception.hpp"
+#include "Resolver.hpp"
+#include "ValueSum.hpp"
+
+// Same constant on both sides of a branch
+static bool same(const ValueSum &a, const ValueSum &b) {
+    if (is_number(a) && is_number(b))
+        return number_of(a) == number_of(b);
+    return a.bits == b.bits;
+}
+
+void Optimizer::optimize(Program &program) {
+    this->program = &program;
+    Constants known;
+    program.root = optimize(program.root, known);
+}
+
+ASTNode *Optimizer::optimize(ASTNode *node, Constants &known) {
+    if (auto func = dynamic_cast<Function *>(node)) {
+        if (func->called)
+            return fold(func, known);
+        // The def binds its name, the body runs in a frame of its own
+        known.erase(func->slot);
+        Constants inner;
+        func->func_block = optimize(func->func_block, inner);
+        return func;
+    }
+    auto block = dynamic_cast<Block *>(node);
+    if (!block)
+        return fold(node, known);
+
+    auto &statements = block->statements;
+    switch (block->kind) {
+        case BlockKind::main:
+        case BlockKind::block:
+        case BlockKind::else_: {
+            size_t kept = 0;
+            for (size_t i = 0; i < statements.size(); ++i)
+                if (ASTNode *statement = optimize(statements[i], known))
+                    statements[kept++] = statement;
+            statements.resize(kept);
+            return block;
+        }
+        case BlockKind::if_: {
+            statements[0] = fold(statements[0], known);
+
+            auto cond = dynamic_cast<Value *>(statements[0]);
+            if (cond && is_bool(cond->val)) {
+                // Only one branch can run
+                if (get_bool(cond->val))
+                    return optimize(statements[1], known);
+                return statements.size() == 3 ? optimize(statements[2], known) : nullptr;
+            }
+            // Keep what both branches agree on
+            Constants taken = known;
+            statements[1] = optimize(statements[1], taken);
+            if (statements.size() == 3)
+                statements[2] = optimize(statements[2], known);
+            for (auto it = known.begin(); it != known.end();) {
+                auto other = taken.find(it->first);
+                if (other != taken.end() && same(it->second, other->second))
+                    ++it;
+                else
+                    it = known.erase(it);
+            }
+            return block;
+        }
+        case BlockKind::while_: {
+            // Nothing the loop assigns is constant inside or after it
+            std::vector<uint32_t> slots;
+            Resolver::assigned(block, slots);
+            for (auto slot : slots)
+                known.erase(slot);
+            statements[0] = fold(statements[0], known);
+
+            auto cond = dynamic_cast<Value *>(statements[0]);
+            if (cond && is_bool(cond->val) && !get_bool(cond->val))
+                return nullptr;
+            Constants body = known;
+            statements[1] = optimize(statements[1], body);
+            return block;
+        }
+        case BlockKind::print:
+        case BlockKind::return_:
+            if (!statements.empty())
+                statements[0] = fold(statements[0], known);
+            return block;
+    }
+    return block;
+}
+
+ASTNode *Optimizer::fold(ASTNode *node, Constants &known) {
+    if (auto id = dynamic_cast<Identifier *>(node)) {
+        auto it = known.find(id->slot);
+        return it == known.end() ? node : constant(node, it->second);
+    }
+    if (auto func = dynamic_cast<Function *>(node)) {
+        // A call cannot assign in the caller's frame
+        for (auto &arg : func->call_block)
+            arg = fold(arg, known);
+        return node;
+    }
+    auto op = dynamic_cast<Operator *>(node);
+    if (!op)
+        return node;
+
+    if (op->kind == OpKind::assign) {
+        // Assignees are never evaluated
+        op->sub_expr[0] = fold(op->sub_expr[0], known);
+        auto value = dynamic_cast<Value *>(op->sub_expr[0]);
+        for (size_t i = 1; i < op->sub_expr.size(); ++i) {
+            if (op->sub_expr[i]->type != Type::identifier)
+                break;
+            if (value)
+                known[op->assign_slots[i]] = value->val;
+            else
+                known.erase(op->assign_slots[i]);
+        }
+        return node;
+    }
+
+    bool constant_operands = true;
+    for (auto &sub : op->sub_expr) {
+        sub = fold(sub, known);
+        constant_operands = constant_operands && dynamic_cast<Value *>(sub);
+    }
+    if (!constant_operands)
+        return node;
+    try {
+        return constant(node, op->eval(scratch));
+    }
+    catch (ScryptException &) {
+        // Raised when the program runs instead
+        return node;
+    }
+}
+
+Value *Optimizer::constant(ASTNode *origin, ValueSum val) {
+    const SourceLocation &at = program->locations[origin->id];
+    return program->make<Value>(Token{"", at.line, at.column, Type::number}, val);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+#include "ASTNode.hpp"
+#include "Frame.hpp"
+
+// Pass run after Resolver, before the program is evaluated or compiled.
+// Folds operators over constant operands, replaces reads of variables that
+// straight-line code assigned a constant, and drops if branches that can never
+// run. Expressions that would raise a runtime error are left as they are, so
+// the error still happens when execution gets there.
+class Optimizer {
+    public:
+        Optimizer() = default;
+
+        void optimize(Program &program);
+
+    private:
+        // Constant value of a slot in the frame being optimized
+        using Constants = std::unordered_map<uint32_t, ValueSum>;
+
+        // Rewrites a statement, returns nullptr when it never has an effect
+        ASTNode *optimize(ASTNode *node, Constants &known);
+        // Rewrites an expression, returns the node to evaluate in its place
+        ASTNode *fold(ASTNode *node, Constants &known);
+        // A Value node at the source location of origin
+        Value *constant(ASTNode *origin, ValueSum val);
+
+        Program *program = nullptr;
+        Frame scratch{};  // Folded operators only read their Value operands
+};
@@ -0,0 +1,37 @@
+#include <algorithm>
+#include <cstring>
+
+#include "Output.hpp"
+
+Output::Output(std::ostream &target, Mode mode, size_t capacity)
+    : target(target), mode(mode), buffer(new char[capacity]), capacity(capacity) {}
+
+Output::~Output() { flush(); }
+
+void Output::write(std::string_view text) {
+    bool newline = mode == Mode::line && text.find('\n') != std::string_view::npos;
+    while (!text.empty()) {
+        if (used == capacity)
+            flush();
+        size_t n = std::min(text.size(), capacity - used);
+        std::memcpy(buffer.get() + used, text.data(), n);
+        used += n;
+        text.remove_prefix(n);
+    }
+    if (newline)
+        flush();
+}
+
+void Output::put(char c) {
+    if (used == capacity)
+        flush();
+    buffer[used++] = c;
+    if (c == '\n' && mode == Mode::line)
+        flush();
+}
+
+void Output::flush() {
+    target.write(buffer.get(), used);
+    target.flush();
+    used = 0;
+}
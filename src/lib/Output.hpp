@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string_view>
+
+// Destination of print. Text is collected in a fixed size buffer and handed to
+// the target stream when the buffer is full, at the end of every line in line
+// mode, or on flush(), so memory use does not grow with the amount of output.
+class Output {
+    public:
+        enum class Mode {
+            full,   // flush only when the buffer is full
+            line    // also flush after every newline
+        };
+
+        Output(std::ostream &target, Mode mode = Mode::full, size_t capacity = 8 * 1024);
+        ~Output();
+        Output(const Output &) = delete;
+        Output &operator=(const Output &) = delete;
+
+        void write(std::string_view text);
+        void put(char c);
+        // Writes out everything buffered so far
+        void flush();
+
+    private:
+        std::ostream &target;
+        Mode mode;
+        std::unique_ptr<char[]> buffer;
+        size_t capacity;
+        size_t used = 0;
+};
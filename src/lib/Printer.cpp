@@ -0,0 +1,167 @@
+#include <sstream>
+
+#include "Printer.hpp"
+#include "ValueSum.hpp"
+
+static const std::string_view TAB = "    ";  // 4 spaces
+
+// Expression statements left empty by the parser
+static bool is_blank(ASTNode *node) {
+    auto id = dynamic_cast<Identifier *>(node);
+    return id && id->name == "__blank__";
+}
+
+Printer::Printer(Output &output) : output(output) {}
+
+std::string Printer::to_string(ASTNode *node) {
+    std::ostringstream stream;
+    {
+        Output output(stream);
+        Printer(output).print(node);
+    }
+    return stream.str();
+}
+
+void Printer::print(ASTNode *node) {
+    if (auto value = dynamic_cast<Value *>(node))
+        write(vsum_to_string(value->val));
+    else if (auto id = dynamic_cast<Identifier *>(node))
+        write(id->name);
+    else if (auto op = dynamic_cast<Operator *>(node))
+        print_operator(op);
+    else if (auto block = dynamic_cast<Block *>(node))
+        print_block(block);
+    else if (auto func = dynamic_cast<Function *>(node))
+        print_function(func);
+}
+
+void Printer::print_block(Block *block) {
+    BlockKind kind = block->kind;
+    bool list = kind == BlockKind::main || kind == BlockKind::block;
+    auto &statements = block->statements;
+
+    if (!list) {
+        if (kind == BlockKind::else_)
+            newline();
+        // Print statement token
+        write(block_text(kind));
+        if (!statements.empty() && !is_blank(statements[0]))
+            write(" ");
+    }
+    ASTNode *prev = nullptr;
+    for (size_t i = 0; i < statements.size(); ++i) {
+        ASTNode *statement = statements[i];
+        // expr -> (expr)
+        if (statement->type != Type::statement) {
+            if (!is_blank(statement))
+                print(statement);
+            if (list || kind == BlockKind::else_ || kind == BlockKind::print || kind == BlockKind::return_)
+                write(";");
+        }
+        else if (statement->is_braced()) {
+            // We are in some braced block
+            if (prev && prev->type != Type::statement)
+                write(" ");
+            open_brace();
+            print(statement);
+            close_brace();
+        }
+        else
+            print(statement);
+        prev = statement;
+        if (list && i != statements.size() - 1)
+            newline();
+    }
+}
+
+void Printer::print_function(Function *func) {
+    // function called: foo(...)
+    if (func->called) {
+        write(func->name);
+        write("(");
+        for (size_t i = 0; i < func->call_block.size(); ++i) {
+            if (i > 0)
+                write(", ");
+            print(func->call_block[i]);
+        }
+        write(")");
+        return;
+    }
+    // Function declaration
+    // def foo(x, y, ..., z) {...}
+    write("def ");
+    write(func->name);
+    write("(");
+    for (size_t i = 0; i < func->arg_names.size(); ++i) {
+        if (i > 0)
+            write(", ");
+        write(func->arg_names[i]);
+    }
+    write(") ");
+    // An empty body closes on the next line, without indentation
+    auto body = dynamic_cast<Block *>(func->func_block);
+    if (body && body->statements.empty()) {
+        write("{");
+        newline();
+        write("}");
+        return;
+    }
+    open_brace();
+    print(func->func_block);
+    close_brace();
+}
+
+void Printer::print_operator(Operator *op) {
+    auto &sub_expr = op->sub_expr;
+    write("(");
+    if (sub_expr.size() > 1) {
+        // Assignments keep the assignee last
+        if (op->kind == OpKind::assign) {
+            print(sub_expr.back());
+            for (size_t i = sub_expr.size() - 1; i-- > 0;) {
+                write(" ");
+                write(op_text(op->kind));
+                write(" ");
+                print(sub_expr[i]);
+            }
+        }
+        else {
+            print(sub_expr[0]);
+            for (size_t i = 1; i < sub_expr.size(); ++i) {
+                write(" ");
+                write(op_text(op->kind));
+                write(" ");
+                print(sub_expr[i]);
+            }
+        }
+    }
+    write(")");
+}
+
+void Printer::write(std::string_view text) {
+    if (indent) {
+        for (int i = 0; i < depth; ++i)
+            output.write(TAB);
+        indent = false;
+    }
+    output.write(text);
+}
+
+void Printer::newline() {
+    write("\n");
+    indent = true;
+}
+
+void Printer::open_brace() {
+    write("{");
+    newline();
+    ++depth;
+    // The first line is indented even if the body prints nothing
+    write("");
+}
+
+void Printer::close_brace() {
+    --depth;
+    newline();
+    write("}");
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "ASTNode.hpp"
+#include "Output.hpp"
+
+// Writes the source form of a tree in one visit. Lines inside braces are indented
+// by 4 spaces per level, the indentation of a line is written with its first text.
+class Printer {
+    public:
+        Printer(Output &output);
+
+        void print(ASTNode *node);
+
+        // Source form of node as a string
+        static std::string to_string(ASTNode *node);
+
+    private:
+        void print_block(Block *block);
+        void print_function(Function *func);
+        void print_operator(Operator *op);
+
+        void write(std::string_view text);
+        void newline();
+        // "{" and "}" around an indented body
+        void open_brace();
+        void close_brace();
+
+        Output &output;
+        int depth = 0;
+        bool indent = false;    // The last thing written was a newline
+};
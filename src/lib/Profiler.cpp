@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <string>
+#include <utility>
+
+#include "Profiler.hpp"
+
+Profiler::Profiler(const Program &program) : program(program) {
+    int last = 0;
+    for (auto &location : program.locations)
+        last = std::max(last, location.line);
+    lines.resize(last + 1);
+    root.name = "<main>";
+}
+
+int64_t Profiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::enter(std::vector<Entry> &stack, Stats &stats) {
+    ++stats.count;
+    ++stats.active;
+    stack.push_back(Entry{&stats, now()});
+}
+
+int64_t Profiler::leave(std::vector<Entry> &stack) {
+    Entry entry = stack.back();
+    stack.pop_back();
+    int64_t elapsed = now() - entry.start;
+    entry.stats->exclusive += elapsed - entry.nested;
+    // A recursive entry is already inside the outermost one's time
+    if (--entry.stats->active == 0)
+        entry.stats->inclusive += elapsed;
+    if (!stack.empty())
+        stack.back().nested += elapsed;
+    return elapsed - entry.nested;
+}
+
+Completion Profiler::run(ASTNode *root_block, Frame &frame) {
+    enter(calls, main);
+    Completion completion;
+    try {
+        completion = root_block->exec(frame);
+    }
+    catch (...) {
+        root.self += leave(calls);
+        throw;
+    }
+    root.self += leave(calls);
+    return completion;
+}
+
+Completion Profiler::exec(ASTNode *statement, Frame &frame) {
+    // Blocks the parser made up have no line, their time stays with the enclosing one
+    int line = program.locations[statement->id].line;
+    if (line <= 0)
+        return statement->exec(frame);
+    enter(statements, lines[line]);
+    Completion completion;
+    try {
+        completion = statement->exec(frame);
+    }
+    catch (...) {
+        leave(statements);
+        throw;
+    }
+    leave(statements);
+    return completion;
+}
+
+Completion Profiler::call(Function *func, Frame &callee) {
+    auto &child = current->children[func->name];
+    if (!child) {
+        child = std::make_unique<Stack>();
+        child->name = func->name;
+        child->parent = current;
+    }
+    current = child.get();
+    enter(calls, functions[func->name]);
+    Completion completion;
+    try {
+        completion = func->func_block->exec(callee);
+    }
+    catch (...) {
+        current->self += leave(calls);
+        current = current->parent;
+        throw;
+    }
+    current->self += leave(calls);
+    current = current->parent;
+    return completion;
+}
+
+static double ms(int64_t ns) { return ns / 1e6; }
+
+void Profiler::report(std::ostream &out, std::string_view source) const {
+    // Text of every line, numbered from 1 like the tokens
+    std::vector<std::string_view> text(1);
+    for (size_t begin = 0; begin <= source.size();) {
+        size_t end = std::min(source.find('\n', begin), source.size());
+        text.push_back(source.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    int64_t total = std::max<int64_t>(main.inclusive, 1);
+    auto percent = [&](int64_t ns) { return 100.0 * ns / total; };
+
+    out << std::fixed << std::setprecision(3);
+    out << "Total " << ms(main.inclusive) << " ms\n\n";
+
+    std::vector<std::pair<int, const Stats *>> by_line;
+    for (size_t line = 0; line < lines.size(); ++line)
+        if (lines[line].count)
+            by_line.emplace_back(line, &lines[line]);
+    std::stable_sort(by_line.begin(), by_line.end(),
+        [](auto &a, auto &b) { return a.second->exclusive > b.second->exclusive; });
+    out << "Lines by self time\n"
+        << std::setw(6) << "line" << std::setw(12) << "count" << std::setw(12) << "total ms"
+        << std::setw(12) << "self ms" << std::setw(8) << "self %" << "  source\n";
+    for (auto &[line, stats] : by_line) {
+        std::string_view code = static_cast<size_t>(line) < text.size() ? text[line] : "";
+        code.remove_prefix(std::min(code.find_first_not_of(" \t"), code.size()));
+        if (code.size() > 60)
+            code = code.substr(0, 60);
+        out << std::setw(6) << line << std::setw(12) << stats->count
+            << std::setw(12) << ms(stats->inclusive) << std::setw(12) << ms(stats->exclusive)
+            << std::setw(7) << std::setprecision(1) << percent(stats->exclusive) << "%"
+            << std::setprecision(3) << "  " << code << "\n";
+    }
+
+    std::vector<std::pair<std::string_view, const Stats *>> by_function;
+    for (auto &[name, stats] : functions)
+        by_function.emplace_back(name, &stats);
+    std::stable_sort(by_function.begin(), by_function.end(),
+        [](auto &a, auto &b) { return a.second->exclusive > b.second->exclusive; });
+    out << "\nFunctions by self time\n"
+        << std::setw(12) << "calls" << std::setw(12) << "total ms" << std::setw(12) << "self ms"
+        << std::setw(8) << "self %" << "  name\n";
+    for (auto &[name, stats] : by_function)
+        out << std::setw(12) << stats->count << std::setw(12) << ms(stats->inclusive)
+            << std::setw(12) << ms(stats->exclusive)
+            << std::setw(7) << std::setprecision(1) << percent(stats->exclusive) << "%"
+            << std::setprecision(3) << "  " << name << "\n";
+}
+
+void Profiler::collapsed(std::ostream &out) const {
+    std::string path;
+    write_stacks(out, root, path);
+}
+
+void Profiler::write_stacks(std::ostream &out, const Stack &stack, std::string &path) const {
+    size_t length = path.size();
+    if (!path.empty())
+        path += ';';
+    path += stack.name;
+    if (stack.self > 0)
+        out << path << ' ' << stack.self << '\n';
+    for (auto &[name, child] : stack.children)
+        write_stacks(out, *child, path);
+    path.resize(length);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ASTNode.hpp"
+#include "Frame.hpp"
+
+// Statement and call profiler for the tree-walking evaluator, on with
+// scrypt --profile. Block::exec hands each statement to exec() and
+// Function::eval each call to call() when FrameStack::profiler is set, so the
+// only cost when profiling is off is that test. Times are wall clock.
+class Profiler {
+    public:
+        explicit Profiler(const Program &program);
+
+        // Runs the main block of the program, the root of every stack
+        Completion run(ASTNode *root_block, Frame &frame);
+        // Runs statement, its time is charged to its source line
+        Completion exec(ASTNode *statement, Frame &frame);
+        // Runs the body of func in callee, its time is charged to the function
+        Completion call(Function *func, Frame &callee);
+
+        // Lines and functions sorted by exclusive time, source gives the line text
+        void report(std::ostream &out, std::string_view source) const;
+        // One "<main>;f;g <nanoseconds>" line per call stack, for flame graphs
+        void collapsed(std::ostream &out) const;
+
+    private:
+        struct Stats {
+            uint64_t count = 0;
+            int64_t inclusive = 0;  // ns, recursive entries are counted once
+            int64_t exclusive = 0;  // ns, without nested statements or calls
+            uint32_t active = 0;    // entries on the stack
+        };
+        // A call stack, children are keyed by function name
+        struct Stack {
+            std::string_view name;
+            Stack *parent = nullptr;
+            int64_t self = 0;  // ns
+            std::map<std::string_view, std::unique_ptr<Stack>> children;
+        };
+        struct Entry {
+            Stats *stats;
+            int64_t start;
+            int64_t nested = 0;  // ns spent in entries above this one
+        };
+
+        static int64_t now();
+        static void enter(std::vector<Entry> &stack, Stats &stats);
+        // Pops the top entry of stack and returns its exclusive time
+        static int64_t leave(std::vector<Entry> &stack);
+        void write_stacks(std::ostream &out, const Stack &stack, std::string &path) const;
+
+        const Program &program;
+        std::vector<Stats> lines;  // by source line
+        std::map<std::string_view, Stats> functions;
+        Stats main;
+        Stack root;
+        Stack *current = &root;
+        std::vector<Entry> statements;  // statements being executed, innermost last
+        std::vector<Entry> calls;       // calls being executed, main first
+};
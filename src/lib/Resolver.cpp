@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <string>
+
+#include "Resolver.hpp"
+#include "ASTNode.hpp"
+#include "Environment.hpp"
+#include "Symbols.hpp"
+
+void Resolver::resolve(Program &program) {
+    resolve(program.root, program.globals);
+}
+
+void Resolver::resolve(ASTNode *node, Environment *env) {
+    if (auto id = dynamic_cast<Identifier *>(node)) {
+        id->slot = env->resolve(id->atom);
+    }
+    else if (auto op = dynamic_cast<Operator *>(node)) {
+        op->assign_slots.assign(op->sub_expr.size(), 0);
+        for (size_t i = 0; i < op->sub_expr.size(); ++i) {
+            resolve(op->sub_expr[i], env);
+            // Assignees are bound under their printed name, as Environment::add did
+            if (op->kind == OpKind::assign && i > 0 && op->sub_expr[i]->type == Type::identifier) {
+                auto id = dynamic_cast<Identifier *>(op->sub_expr[i]);
+                op->assign_slots[i] = env->resolve(id ? id->atom : Symbols::table().intern(op->sub_expr[i]->to_string()));
+            }
+        }
+    }
+    else if (auto block = dynamic_cast<Block *>(node)) {
+        // return f(...) in a function reuses its frame for the call
+        if (block->kind == BlockKind::return_ && depth > 0 && block->statements.size() == 1) {
+            auto call = dynamic_cast<Function *>(block->statements[0]);
+            block->tail_call = call && call->called;
+        }
+        for (auto statement : block->statements) {
+            // Definitions bind their name in the block's env
+            auto func = dynamic_cast<Function *>(statement);
+            if (func && !func->called)
+                func->slot = env->resolve(func->atom);
+            resolve(statement, env);
+        }
+    }
+    else if (auto func = dynamic_cast<Function *>(node)) {
+        if (func->called) {
+            // Callee is looked up in the calling env
+            func->slot = env->resolve(func->atom);
+            for (auto arg : func->call_block)
+                resolve(arg, env);
+        }
+        else {
+            // Arguments are bound in the closure env
+            func->arg_slots.clear();
+            for (auto arg : func->arg_atoms)
+                func->arg_slots.push_back(func->closure->resolve(arg));
+            ++depth;
+            resolve(func->func_block, func->closure);
+            --depth;
+            // Everything else the body refers to is captured from env when the def
+            // runs. Resolving the names here also gives the defs this one is nested
+            // in slots to capture them into.
+            Environment *closure = func->closure;
+            func->captures.clear();
+            for (uint32_t slot = 0; slot < closure->atoms.size(); ++slot)
+                if (std::find(func->arg_slots.begin(), func->arg_slots.end(), slot) == func->arg_slots.end())
+                    func->captures.push_back({env->resolve(closure->atoms[slot]), slot});
+        }
+    }
+}
+
+void Resolver::assigned(ASTNode *node, std::vector<uint32_t> &slots) {
+    if (auto op = dynamic_cast<Operator *>(node)) {
+        if (op->kind == OpKind::assign)
+            for (size_t i = 1; i < op->sub_expr.size(); ++i)
+                slots.push_back(op->assign_slots[i]);
+        for (auto sub : op->sub_expr)
+            assigned(sub, slots);
+    }
+    else if (auto block = dynamic_cast<Block *>(node)) {
+        for (auto statement : block->statements)
+            assigned(statement, slots);
+    }
+    else if (auto func = dynamic_cast<Function *>(node)) {
+        if (!func->called)
+            slots.push_back(func->slot);
+        for (auto arg : func->call_block)
+            assigned(arg, slots);
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ASTNode.hpp"
+#include "Environment.hpp"
+
+// Pass run once after parsing. Gives every variable a slot in the frame of the
+// Environment it belongs to and stores it on the nodes that read or write it,
+// so evaluation never looks a name up.
+class Resolver {
+    public:
+        Resolver() = default;
+
+        void resolve(Program &program);
+        // node is evaluated in env, function bodies in their closure
+        void resolve(ASTNode *node, Environment *env);
+
+        // Slots node may assign in its frame, function bodies are not entered
+        static void assigned(ASTNode *node, std::vector<uint32_t> &slots);
+
+    private:
+        int depth = 0;  // Function bodies being resolved
+};
@@ -12,114 +12,109 @@
 #include "Scrypt.hpp"
 #include "Exception.hpp"
 #include "Environment.hpp"
+#include "Resolver.hpp"
+#include "Symbols.hpp"
 
-Scrypt::Parser::Parser(std::deque<Token> input) { this->input = input; }
-std::shared_ptr<ASTNode> Scrypt::Parser::parse() {
-    if (input.size() == 1 && input[0].type == Type::END)
+Scrypt::Parser::Parser(TokenSpan input) : input(input) {}
+
+// Names of defs and their arguments are taken from whatever token is there
+static uint32_t atom_of(const Token &token) {
+    return token.atom != Symbols::NONE ? token.atom : Symbols::table().intern(token.text);
+}
+
+std::shared_ptr<Program> Scrypt::Parser::parse() {
+    if (input.size() == 1 && input.type(0) == Type::END)
         throw UnexpectedToken(input[0], 1);
-    // Check if parentheses are balanced
+    // Check if parentheses are balanced, and pair up the curly braces
     int open_paren = 0, open_curly = 0;
+    closing.assign(input.size(), NO_CLOSING);
+    std::vector<size_t> unclosed;
     for (size_t i = 0; i < input.size(); ++i) {
         Token token = input[i];
         if (token.type == Type::left_paren) open_paren++;
         else if (token.type == Type::right_paren) open_paren--;
-        else if (token.type == Type::left_curly) open_curly++;
-        else if (token.type == Type::right_curly) open_curly--;
+        else if (token.type == Type::left_curly) {
+            open_curly++;
+            unclosed.push_back(i);
+        }
+        else if (token.type == Type::right_curly) {
+            open_curly--;
+            if (!unclosed.empty()) {
+                closing[unclosed.back()] = i;
+                unclosed.pop_back();
+            }
+        }
 
         if (open_curly < 0 || open_paren < 0)
             throw UnexpectedToken(token);
     }
-    // Create our global environment
-    auto sp = std::shared_ptr<Environment>(new Environment());
-    return parse(input, sp);
+    // The program owns the nodes and our global environment
+    program = std::make_shared<Program>();
+    program->root = parse_block(0, input.size(), BlockKind::main);
+    // Assign frame slots to every variable
+    Resolver().resolve(*program);
+    return program;
 }
-std::shared_ptr<ASTNode> Scrypt::Parser::parse(std::deque<Token> &tokens, std::shared_ptr<Environment> env, std::string block_type) {
-    std::shared_ptr<Block> block(new Block(Token{block_type, -1, -1, Type::statement}, env, block_type == "__block__"));
 
-    auto get_next_expr = [&](size_t &pos){
-        // Return the next expression from tokens, starting at index pos
-        // fixes pos at the next token after the expression
-        // Greedily take tokens until a statement, curly or next line
-        // size_t start = pos;
-        std::deque<Token> expr;
-        for ( ; pos < tokens.size(); ++pos) {
-            // check valid type
-            // expression could terminate at semicolon, statement, left_curly
-            if (tokens[pos].type == Type::semi_colon || tokens[pos].type == Type::statement || tokens[pos].type == Type::left_curly)
-                break;
-            // // check same position as start
-            // if (tokens[pos].line_number != tokens[start].line_number)
-            //     break;
-            expr.push_back(tokens[pos]);
-        }
-        // std::cout << "Expression: " << std::endl;
-        // for (Token token : expr) {
-        //     std::cout << std::right << std::setw(4) << token.line_number 
-        //             << std::setw(5) << token.column_number 
-        //             << "  " << token.text << std::endl;
-        // }
-        if (expr.empty()) {
-            std::shared_ptr<ASTNode> ret(new Identifier(Token{"__blank__", -1, -1, Type::identifier}, env));
-            return ret;
-        }
-        expr.push_front(Token{"(", -1, -1, Type::left_paren});
-        expr.push_back(Token{")", -1, -1, Type::right_paren});
-        return Infix::Parser(expr).parse(expr, env);
-        // }
-        // return ret;
-    };
+ASTNode *Scrypt::Parser::parse_expr(size_t &pos, size_t end) {
+    // Return the next expression, starting at index pos
+    // fixes pos at the next token after the expression
+    // Greedily take tokens until a statement, curly or next line
+    size_t start = pos;
+    for ( ; pos < end; ++pos) {
+        // check valid type
+        // expression could terminate at semicolon, statement, left_curly
+        if (input.type(pos) == Type::semi_colon || input.type(pos) == Type::statement || input.type(pos) == Type::left_curly)
+            break;
+    }
+    if (pos == start)
+        return program->make<Identifier>(Token{"__blank__", -1, -1, Type::identifier}, Symbols::table().intern("__blank__"));
+    TokenSpan expr = input.slice(start, pos);
+    return Infix::Parser(expr, program.get()).parse(expr);
+}
 
-    auto get_next_block = [&](size_t &pos, std::shared_ptr<Environment> block_env){
-        // Return the next block from tokens, starting at index pos
-        // fixes pos at the next token after the expression
-        // Expects pos to be the index of the first curly
-        std::deque<Token> braced_block;
-        int unclosed_curly = 0;
-        do {
-            if (tokens[pos].type == Type::left_curly) unclosed_curly++;
-            if (tokens[pos].type == Type::right_curly) unclosed_curly--;
-            braced_block.push_back(tokens[pos]);
-            ++pos;
-        } while (pos < tokens.size() && unclosed_curly > 0);
-        // delete front and back curly braces
-        braced_block.pop_front();
-        braced_block.pop_back();
-        // std::cout << "Block: " << std::endl;
-        // for (Token token : braced_block) {
-        //     std::cout << std::right << std::setw(4) << token.line_number 
-        //             << std::setw(5) << token.column_number 
-        //             << "  " << token.text << std::endl;
-        // }
-        // Empty block added
-        if (braced_block.empty()) {
-            std::shared_ptr<ASTNode> ret(new Block(Token{block_type, -1, -1, Type::statement}, env, block_type == "__block__"));
-            return ret;
-        }
-        return parse(braced_block, block_env, "__block__");
-    };
+ASTNode *Scrypt::Parser::parse_braced(size_t &pos, size_t end, BlockKind outer) {
+    // Return the next block, starting at index pos
+    // fixes pos at the next token after its closing curly
+    // Expects pos to be the index of the first curly
+    if (pos >= end || input.type(pos) != Type::left_curly)
+        throw UnexpectedToken(input[pos]);
+    size_t start = pos;
+    // Without a closing curly in range the block takes the rest of it
+    pos = closing[pos] < end ? closing[pos] + 1 : end;
+    // leave out front and back curly braces
+    if (start + 1 >= pos - 1)
+        // Empty blocks take the kind of the block around them
+        return program->make<Block>(Token{block_text(outer), -1, -1, Type::statement}, program->arena, outer, outer == BlockKind::block);
+    return parse_block(start + 1, pos - 1, BlockKind::block);
+}
+
+ASTNode *Scrypt::Parser::parse_block(size_t begin, size_t end, BlockKind kind) {
+    Arena &arena = program->arena;
+    Block *block = program->make<Block>(Token{block_text(kind), -1, -1, Type::statement}, arena, kind, kind == BlockKind::block);
 
-    for (size_t i = 0; i < tokens.size();) {
-        Token token = tokens[i];
+    for (size_t i = begin; i < end;) {
+        Token token = input[i];
         if (token.type == Type::END) break;
         else if (token.type == Type::statement) {
             if (token.text == "if") {
                 // Create a branch block
-                std::shared_ptr<Block> branch_block(new Block(token, env));
+                Block *branch_block = program->make<Block>(token, arena, BlockKind::if_);
                 // we do not expect a semicolon after condition in if
                 // if cond {}
-                std::shared_ptr<ASTNode> cond        = get_next_expr(++i);
-                std::shared_ptr<ASTNode> braced      = get_next_block(i, env);
+                ASTNode *cond        = parse_expr(++i, end);
+                ASTNode *braced      = parse_braced(i, end, kind);
                 branch_block->add_statement(cond);
                 branch_block->add_statement(braced);
-                std::shared_ptr<Block> curr = branch_block;
+                Block *curr = branch_block;
                 // Optionally create a false branch block
                 // We will keep creating these blocks until weve exhausted all "else if" tokens
-                while (tokens[i].text == "else") {
-                    std::shared_ptr<Block> else_block(new Block(tokens[i], env));
-                    if (tokens[++i].text == "if") {
-                        std::shared_ptr<Block> new_branch_block(new Block(tokens[i], env, "__block__"));
-                        std::shared_ptr<ASTNode> new_cond        = get_next_expr(++i);
-                        std::shared_ptr<ASTNode> new_braced      = get_next_block(i, env);
+                while (input[i].text == "else") {
+                    Block *else_block = program->make<Block>(input[i], arena, BlockKind::else_);
+                    if (input[++i].text == "if") {
+                        Block *new_branch_block = program->make<Block>(input[i], arena, BlockKind::if_, true);
+                        ASTNode *new_cond        = parse_expr(++i, end);
+                        ASTNode *new_braced      = parse_braced(i, end, kind);
                         new_branch_block->add_statement(new_cond);
                         new_branch_block->add_statement(new_braced);     
                         else_block->add_statement(new_branch_block);
@@ -128,7 +123,7 @@ std::shared_ptr<ASTNode> Scrypt::Parser::parse(std::deque<Token> &tokens, std::s
                     }
                     else {
                         // This is the final else block
-                        else_block->add_statement(get_next_block(i, env));
+                        else_block->add_statement(parse_braced(i, end, kind));
                         curr->add_statement(else_block);
                     }
                 }
@@ -136,54 +131,58 @@ std::shared_ptr<ASTNode> Scrypt::Parser::parse(std::deque<Token> &tokens, std::s
                 block->add_statement(branch_block);
             }
             else if (token.text == "while") {
-                std::shared_ptr<Block>   while_block(new Block(token, env));
-                std::shared_ptr<ASTNode> cond        = get_next_expr(++i);
-                std::shared_ptr<ASTNode> braced      = get_next_block(i, env);
+                Block   *while_block = program->make<Block>(token, arena, BlockKind::while_);
+                ASTNode *cond        = parse_expr(++i, end);
+                ASTNode *braced      = parse_braced(i, end, kind);
                 while_block->add_statement(cond);
                 while_block->add_statement(braced);
                 block->add_statement(while_block);
             }
             else if (token.text == "print" || token.text == "return") {
-                std::shared_ptr<Block>   print_block(new Block(token, env));
+                Block   *print_block = program->make<Block>(token, arena, decode_block(token.text));
                 // We expect semicolon after expression in print
                 // print expr;
-                std::shared_ptr<ASTNode> expr = get_next_expr(++i);
-                if (tokens[i++].type != Type::semi_colon)
-                    throw UnexpectedToken(tokens[i-1]);
+                ASTNode *expr = parse_expr(++i, end);
+                if (input[i++].type != Type::semi_colon)
+                    throw UnexpectedToken(input[i-1]);
                 print_block->add_statement(expr);
                 block->add_statement(print_block);
             }
             else if (token.text == "def") {
                 // std::cout << "Def statement found" << std::endl;
-                auto closure = std::shared_ptr<Environment>(new Environment());
+                Environment *closure = program->make_environment();
                 // closure->set_parent(env);
-                Token func_name = tokens[++i];
+                Token func_name = input[++i];
                 // match all arguments
                 // (x, y, ... , z)
-                std::vector<std::string> arg_names = {};
+                std::vector<Token> arg_names = {};
                 // std::cout << "start parsing arg_names" << std::endl;
-                if (tokens[++i].type != Type::left_paren) throw UnexpectedToken(tokens[i-1]);
-                if (tokens[i+1].type == Type::right_paren) {
+                if (input[++i].type != Type::left_paren) throw UnexpectedToken(input[i-1]);
+                if (input[i+1].type == Type::right_paren) {
                     i += 2;
                 }
                 else {
-                    while (tokens[i].type != Type::right_paren) {
+                    while (input[i].type != Type::right_paren) {
+                        if (i >= end)
+                            throw UnexpectedToken(input[end - 1]);
                         // get arg name
-                        arg_names.push_back(tokens[++i].text);
+                        arg_names.push_back(input[++i]);
                         // we now expect either a "," or ")"
-                        if (tokens[++i].type == Type::comma) continue;
-                        else if (tokens[i].type == Type::right_paren) {
+                        if (input[++i].type == Type::comma) continue;
+                        else if (input[i].type == Type::right_paren) {
                             i++; // Point i to next token after closing ")"
                             break;
                         }
                     }
                 }
                 // std::cout << "arg_names parsed" << std::endl;
-                std::shared_ptr<Function> func(new Function(token, closure, func_name.text));
+                Function *func = program->make<Function>(token, arena, atom_of(func_name));
+                func->closure = closure;
                 // std::cout << "Adding func block " << i << std::endl;
-                func->add_func_block(get_next_block(i, closure));
+                func->add_func_block(parse_braced(i, end, kind));
                 // std::cout << "func block added" << std::endl;
-                func->add_arg_names(arg_names);
+                for (Token arg : arg_names)
+                    func->add_arg(atom_of(arg));
                 block->add_statement(func);
                 block->add_function(func);
             }
@@ -191,9 +190,9 @@ std::shared_ptr<ASTNode> Scrypt::Parser::parse(std::deque<Token> &tokens, std::s
         else if (token.type != Type::statement) {
             // We expect semicolon after bare expression
             // expr;
-            block->add_statement(get_next_expr(i));
-            if (tokens[i++].type != Type::semi_colon)
-                throw UnexpectedToken(tokens[i-1]);
+            block->add_statement(parse_expr(i, end));
+            if (input[i++].type != Type::semi_colon)
+                throw UnexpectedToken(input[i-1]);
         }
     }
     return block;
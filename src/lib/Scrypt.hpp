@@ -16,12 +16,21 @@ namespace Scrypt {
 
 class Parser {
     public:
-        std::shared_ptr<ASTNode> parse();
-        std::shared_ptr<ASTNode> parse(std::deque<Token> &tokens, std::shared_ptr<Environment> env, std::string block_type = "__main__");
+        std::shared_ptr<Program> parse();
+        // Statements of input[begin, end), a block of the given kind
+        ASTNode *parse_block(size_t begin, size_t end, BlockKind kind);
+        // Expression starting at pos, pos is left on the token after it
+        ASTNode *parse_expr(size_t &pos, size_t end);
+        // Braced block starting at pos, pos is left on the token after it
+        ASTNode *parse_braced(size_t &pos, size_t end, BlockKind outer);
 
-        Parser(std::deque<Token> input);
+        Parser(TokenSpan input);
     
-        std::deque<Token> input;
+        TokenSpan input;
+        std::shared_ptr<Program> program;
+        // Index of the matching right curly of every left curly in input
+        std::vector<size_t> closing;
+        static constexpr size_t NO_CLOSING = static_cast<size_t>(-1);
 };
 
 }
\ No newline at end of file
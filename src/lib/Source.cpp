@@ -0,0 +1,44 @@
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Source.hpp"
+
+Source::Source(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) < 0) {
+        if (fd >= 0) close(fd);
+        throw std::runtime_error("Cannot open " + path);
+    }
+    size = info.st_size;
+    // Empty files can't be mapped, they are just empty text
+    if (size > 0) {
+        void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Cannot map " + path);
+        }
+        mapped = static_cast<const char *>(data);
+    }
+    // The mapping stays valid after the file is closed
+    close(fd);
+}
+
+Source::Source(std::istream &stream) {
+    char chunk[64 * 1024];
+    while (stream.read(chunk, sizeof(chunk)) || stream.gcount() > 0)
+        buffer.append(chunk, stream.gcount());
+    size = buffer.size();
+}
+
+Source::~Source() {
+    if (mapped)
+        munmap(const_cast<char *>(mapped), size);
+}
+
+std::string_view Source::text() const {
+    return mapped ? std::string_view(mapped, size) : std::string_view(buffer);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <string_view>
+
+// The whole text of a program in one contiguous buffer. Files are memory mapped,
+// streams are read in one go. Tokens are views of this text, so it has to outlive them.
+class Source {
+    public:
+        // Maps the file at path, throws std::runtime_error if it can't be opened
+        explicit Source(const std::string &path);
+        // Reads stream until its end
+        explicit Source(std::istream &stream);
+        ~Source();
+        Source(const Source &) = delete;
+        Source &operator=(const Source &) = delete;
+
+        std::string_view text() const;
+
+    private:
+        std::string buffer;             // Contents when read from a stream
+        const char *mapped = nullptr;   // Contents when mapped from a file
+        size_t size = 0;
+};
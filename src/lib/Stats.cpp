@@ -0,0 +1,97 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "Stats.hpp"
+#include "Symbols.hpp"
+
+// Every operator new of the process comes through here. The program is single
+// threaded, so plain counters will do.
+static size_t allocation_count = 0;
+static size_t allocation_bytes = 0;
+
+void *operator new(std::size_t size) {
+    ++allocation_count;
+    allocation_bytes += size;
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+// The library's own nothrow version would pair an uncounted allocation with the free below
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    ++allocation_count;
+    allocation_bytes += size;
+    return std::malloc(size ? size : 1);
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+size_t Stats::allocations() { return allocation_count; }
+size_t Stats::allocated_bytes() { return allocation_bytes; }
+
+int64_t Stats::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Stats::Stats(std::string driver) : driver(std::move(driver)), start(now()) {
+    if (const char *env = std::getenv("SCRYPT_STATS"))
+        destination = env;
+}
+
+Stats::~Stats() {
+    if (enabled())
+        write();
+}
+
+Stats::Timer::Timer(Stats &stats, Phase phase)
+    : stats(stats.enabled() ? &stats : nullptr), phase(phase) {
+    if (this->stats)
+        start = now();
+}
+
+Stats::Timer::~Timer() {
+    if (stats)
+        stats->phases[static_cast<int>(phase)] += now() - start;
+}
+
+void Stats::write() const {
+    static const char *names[] = { "lex", "parse", "optimize", "eval", "format" };
+    struct rusage usage;
+    long max_rss = getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+
+    std::ostringstream out;
+    out << "{\"driver\": \"" << driver << "\""
+        << ", \"exit_code\": " << status
+        << ", \"wall_ns\": " << now() - start
+        << ", \"phases_ns\": {";
+    for (int i = 0; i < 5; ++i)
+        out << (i ? ", \"" : "\"") << names[i] << "\": " << phases[i];
+    out << "}"
+        << ", \"tokens\": " << tokens
+        << ", \"ast_nodes\": " << nodes
+        << ", \"peak_environment_slots\": " << peak_slots
+        << ", \"allocations\": " << allocation_count
+        << ", \"allocated_bytes\": " << allocation_bytes
+        << ", \"arena_bytes\": " << arena_bytes + Symbols::table().bytes_reserved()
+        << ", \"max_rss_kb\": " << max_rss
+        << "}\n";
+    std::string line = out.str();
+
+    if (destination == "-" || destination == "stderr") {
+        std::cerr << line << std::flush;
+        return;
+    }
+    // One write to a file opened for appending, so runs sharing a file keep whole lines
+    int fd = open(destination.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0 || ::write(fd, line.data(), line.size()) != static_cast<ssize_t>(line.size()))
+        std::cerr << "Cannot write stats to " << destination << std::endl;
+    if (fd >= 0)
+        close(fd);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Counters of one run of a driver. When the SCRYPT_STATS environment variable
+// is set they are written as one line of JSON when the Stats goes away: to
+// stderr if it is "-" or "stderr", appended to the file it names otherwise.
+// Heap allocations are counted for the whole process by the operator new in
+// Stats.cpp. Arenas take their blocks from malloc, so they are reported apart.
+class Stats {
+    public:
+        enum class Phase { lex, parse, optimize, eval, format };
+
+        explicit Stats(std::string driver);
+        ~Stats();
+        Stats(const Stats &) = delete;
+        Stats &operator=(const Stats &) = delete;
+
+        // Adds the time until it goes away to a phase, nothing when stats are off
+        class Timer {
+            public:
+                Timer(Stats &stats, Phase phase);
+                ~Timer();
+                Timer(const Timer &) = delete;
+                Timer &operator=(const Timer &) = delete;
+
+            private:
+                Stats *stats;  // nullptr when stats are off
+                Phase phase;
+                int64_t start = 0;
+        };
+
+        bool enabled() const { return !destination.empty(); }
+        void count_tokens(size_t count) { tokens += count; }
+        void count_nodes(size_t count) { nodes += count; }
+        // Records the number of slots of an environment, the largest is kept
+        void environment(size_t slots) { if (slots > peak_slots) peak_slots = slots; }
+        // Adds the bytes an AST arena took, the symbol table's are added when written
+        void arena(size_t bytes) { arena_bytes += bytes; }
+        void exit_code(int code) { status = code; }
+
+        // Allocations by operator new since the process started
+        static size_t allocations();
+        static size_t allocated_bytes();
+
+    private:
+        static int64_t now();
+        void write() const;
+
+        std::string driver;
+        std::string destination;  // empty when stats are off
+        int64_t phases[5] = {};   // ns, by Phase
+        int64_t start;
+        size_t tokens = 0;
+        size_t nodes = 0;
+        size_t peak_slots = 0;
+        size_t arena_bytes = 0;
+        int status = 0;
+};
@@ -0,0 +1,17 @@
+#include "Symbols.hpp"
+
+Symbols &Symbols::table() {
+    static Symbols symbols;
+    return symbols;
+}
+
+uint32_t Symbols::intern(std::string_view name) {
+    auto it = atoms.find(name);
+    if (it != atoms.end())
+        return it->second;
+    uint32_t atom = names.size();
+    std::string_view stored = arena.copy(name);
+    names.push_back(stored);
+    atoms.emplace(stored, atom);
+    return atom;
+}
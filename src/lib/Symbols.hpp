@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Arena.hpp"
+
+// Table of every distinct identifier of the process. The lexer turns each one
+// into a small integer atom, after that names are compared and hashed as atoms.
+// A name is stored once and lives until the process ends, so nodes keep views
+// of it instead of copies.
+class Symbols {
+    public:
+        static constexpr uint32_t NONE = UINT32_MAX;  // Atom of tokens that are not identifiers
+
+        // The table shared by every lexer, parser and Environment
+        static Symbols &table();
+
+        // Atom of name, a new one for names not seen before
+        uint32_t intern(std::string_view name);
+        std::string_view name(uint32_t atom) const { return names[atom]; }
+        size_t size() const { return names.size(); }
+        size_t bytes_reserved() const { return arena.bytes_reserved(); }
+
+    private:
+        Symbols() = default;
+
+        Arena arena;  // Texts of the names
+        std::vector<std::string_view> names;
+        std::unordered_map<std::string_view, uint32_t> atoms;
+};
@@ -0,0 +1,59 @@
+#include <algorithm>
+#include <functional>
+
+#include "Token.hpp"
+
+TokenStream::TokenStream(std::string_view source) : source(source) {}
+
+void TokenStream::push(Type type, std::string_view text, int line, int column) {
+    std::less_equal<const char *> before;
+    uint32_t offset;
+    if (before(source.data(), text.data()) && before(text.data() + text.size(), source.data() + source.size()))
+        offset = text.data() - source.data();
+    else {
+        offset = extra.size() | EXTRA;
+        extra += text;
+    }
+    types.push_back(type);
+    offsets.push_back(offset);
+    lengths.push_back(text.size());
+    lines.push_back(line);
+    columns.push_back(column);
+    atoms.push_back(type == Type::identifier ? Symbols::table().intern(text) : Symbols::NONE);
+}
+
+std::string_view TokenStream::text(size_t i) const {
+    if (offsets[i] & EXTRA)
+        return std::string_view(extra).substr(offsets[i] & ~EXTRA, lengths[i]);
+    return source.substr(offsets[i], lengths[i]);
+}
+
+Token TokenStream::operator[](size_t i) const {
+    return Token{text(i), lines[i], columns[i], types[i], atoms[i]};
+}
+
+TokenSpan::TokenSpan(const TokenStream &stream) : TokenSpan(stream, 0, stream.size()) {}
+
+TokenSpan::TokenSpan(const TokenStream &stream, size_t begin, size_t end)
+    : stream(&stream), begin(begin), end(end) {}
+
+Type TokenSpan::type(size_t i) const {
+    // Past the end, carry on with the tokens that follow in the stream
+    i = std::min(begin + i, stream->size() - 1);
+    if (i < stream->size())
+        return stream->type(i);
+    return Type::END;
+}
+
+Token TokenSpan::operator[](size_t i) const {
+    i = std::min(begin + i, stream->size() - 1);
+    if (i < stream->size())
+        return (*stream)[i];
+    return Token{"END", -1, -1, Type::END};
+}
+
+TokenSpan TokenSpan::slice(size_t from, size_t to) const {
+    to = std::min(to, size());
+    from = std::min(from, to);
+    return TokenSpan(*stream, begin + from, begin + to);
+}
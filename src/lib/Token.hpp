@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Symbols.hpp"
+
+enum class Type : uint8_t {
+    left_paren,    
+    right_paren,
+    left_curly,
+    right_curly,
+    comma,
+    semi_colon,
+    boolean,
+    statement,
+    null,
+    number,        
+    op,    
+    identifier,
+    assignment,        
+    END            
+};
+
+struct Token {
+    std::string_view text;  // View of the source text
+    int line_number;
+    int column_number;
+    Type type;
+    uint32_t atom = Symbols::NONE;  // Identifiers only
+};
+
+// Tokens of a source, stored as parallel arrays. Texts are offsets into the
+// source, a Token is put together when one is asked for.
+class TokenStream {
+    public:
+        TokenStream(std::string_view source = std::string_view());
+
+        // text must be a view of the source, anything else is copied into the stream.
+        // Identifiers are interned in Symbols::table().
+        void push(Type type, std::string_view text, int line, int column);
+
+        size_t size() const { return types.size(); }
+        Type type(size_t i) const { return types[i]; }
+        std::string_view text(size_t i) const;
+        uint32_t atom(size_t i) const { return atoms[i]; }
+        Token operator[](size_t i) const;
+
+    private:
+        // Offsets with this bit set point into extra instead of source
+        static constexpr uint32_t EXTRA = 1u << 31;
+
+        std::string_view source;
+        std::string extra;      // Texts that are not in source, like "END"
+        std::vector<Type> types;
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> lengths;
+        std::vector<int32_t> lines;
+        std::vector<int32_t> columns;
+        std::vector<uint32_t> atoms;  // Symbols::NONE for anything but identifiers
+};
+
+// A range of a TokenStream. Parsers pass these around instead of copying tokens.
+// Reading past the end gives the tokens after the span, and then the last token
+// of the stream.
+class TokenSpan {
+    public:
+        TokenSpan(const TokenStream &stream);
+        TokenSpan(const TokenStream &stream, size_t begin, size_t end);
+
+        size_t size() const { return end - begin; }
+        bool empty() const { return size() == 0; }
+        Type type(size_t i) const;
+        Token operator[](size_t i) const;
+        Token front() const { return (*this)[0]; }
+        Token back() const { return (*this)[size() - 1]; }
+
+        // Tokens [from, to) of this span
+        TokenSpan slice(size_t from, size_t to) const;
+
+    private:
+        const TokenStream *stream;
+        size_t begin;
+        size_t end;
+};
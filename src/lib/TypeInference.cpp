@@ -0,0 +1,153 @@
+#include <vector>
+
+#include "TypeInference.hpp"
+#include "ASTNode.hpp"
+#include "Resolver.hpp"
+#include "ValueSum.hpp"
+
+void TypeInference::infer(Program &program) {
+    Kinds types;
+    infer(program.root, types);
+}
+
+TypeInference::Kind TypeInference::infer(ASTNode *node, Kinds &types) {
+    if (auto value = dynamic_cast<Value *>(node)) {
+        if (is_number(value->val)) return Kind::number;
+        if (is_bool(value->val))   return Kind::boolean;
+        if (is_null(value->val))   return Kind::null;
+        return Kind::unknown;
+    }
+    if (auto id = dynamic_cast<Identifier *>(node)) {
+        auto it = types.find(id->slot);
+        return it == types.end() ? Kind::unknown : it->second;
+    }
+    if (auto op = dynamic_cast<Operator *>(node)) {
+        if (op->kind == OpKind::assign) {
+            Kind kind = infer(op->sub_expr[0], types);
+            for (size_t i = 1; i < op->sub_expr.size(); ++i) {
+                if (op->sub_expr[i]->type != Type::identifier)
+                    break;
+                if (kind == Kind::unknown)
+                    types.erase(op->assign_slots[i]);
+                else
+                    types[op->assign_slots[i]] = kind;
+            }
+            return kind;
+        }
+        if (op->sub_expr.size() != 2) {
+            for (auto sub : op->sub_expr)
+                infer(sub, types);
+            return Kind::unknown;
+        }
+        Kind left = infer(op->sub_expr[0], types);
+        Kind right = infer(op->sub_expr[1], types);
+        if (op->kind == OpKind::equal || op->kind == OpKind::not_equal)
+            return Kind::boolean;
+
+        bool logic = op->kind == OpKind::logic_and || op->kind == OpKind::logic_xor || op->kind == OpKind::logic_or;
+        Kind operand = logic ? Kind::boolean : Kind::number;
+        if (annotate)
+            op->checked = left != operand || right != operand;
+        // Past a checked operator its operands have the right kind, unless
+        // the other operand could have assigned the variable after it was read
+        bool leaves = true;
+        for (auto sub : op->sub_expr)
+            leaves = leaves && (dynamic_cast<Identifier *>(sub) || dynamic_cast<Value *>(sub));
+        for (auto sub : op->sub_expr)
+            if (auto id = dynamic_cast<Identifier *>(sub); id && leaves)
+                types[id->slot] = operand;
+
+        bool arithmetic = op->kind == OpKind::add || op->kind == OpKind::sub || op->kind == OpKind::mul
+                       || op->kind == OpKind::div || op->kind == OpKind::mod;
+        return arithmetic ? Kind::number : Kind::boolean;
+    }
+    if (auto func = dynamic_cast<Function *>(node)) {
+        if (func->called) {
+            // The callee runs in its own frame, only the arguments touch this one
+            for (auto arg : func->call_block)
+                infer(arg, types);
+            return Kind::unknown;
+        }
+        // A def only binds its name the first time it runs
+        types.erase(func->slot);
+        if (annotate) {
+            Kinds inner;
+            infer(func->func_block, inner);
+        }
+        return Kind::unknown;
+    }
+
+    auto block = static_cast<Block *>(node);
+    auto &statements = block->statements;
+    switch (block->kind) {
+        case BlockKind::main:
+        case BlockKind::block:
+        case BlockKind::else_:
+            for (auto statement : statements)
+                infer(statement, types);
+            break;
+        case BlockKind::if_: {
+            Kind cond = infer(statements[0], types);
+            if (annotate)
+                block->checked = cond != Kind::boolean;
+            Kinds taken = types;
+            infer(statements[1], taken);
+            if (statements.size() == 3)
+                infer(statements[2], types);
+            join(types, taken);
+            break;
+        }
+        case BlockKind::while_:
+            infer_while(block, types);
+            break;
+        case BlockKind::print:
+        case BlockKind::return_:
+            if (!statements.empty())
+                infer(statements[0], types);
+            break;
+    }
+    return Kind::unknown;
+}
+
+void TypeInference::infer_while(Block *block, Kinds &types) {
+    ASTNode *cond = block->statements[0];
+    ASTNode *body = block->statements[1];
+    if (!annotate) {
+        // Only the kinds after the loop are needed, forget whatever it assigns
+        std::vector<uint32_t> slots;
+        Resolver::assigned(block, slots);
+        for (auto slot : slots)
+            types.erase(slot);
+        infer(cond, types);
+        return;
+    }
+
+    // Kinds at the head of the loop, narrowed by every iteration until they hold
+    annotate = false;
+    for (;;) {
+        Kinds state = types;
+        infer(cond, state);
+        infer(body, state);
+        Kinds head = types;
+        join(head, state);
+        if (head.size() == types.size())
+            break;
+        types = head;
+    }
+    annotate = true;
+
+    block->checked = infer(cond, types) != Kind::boolean;
+    // The loop exits right after the condition, with the kinds it leaves in types
+    Kinds state = types;
+    infer(body, state);
+}
+
+void TypeInference::join(Kinds &into, const Kinds &other) {
+    for (auto it = into.begin(); it != into.end();) {
+        auto match = other.find(it->first);
+        if (match != other.end() && match->second == it->second)
+            ++it;
+        else
+            it = into.erase(it);
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+#include "ASTNode.hpp"
+
+// Pass run after Resolver (and Optimizer). Follows the type of every slot
+// through the program and clears the checked flag of operators and conditions
+// whose operands are proven to have the type they need, so the evaluator skips
+// the type check. Anything it cannot prove stays checked.
+class TypeInference {
+    public:
+        TypeInference() = default;
+
+        void infer(Program &program);
+
+    private:
+        // What an expression or a slot is known to hold
+        enum class Kind : uint8_t { unknown, number, boolean, null };
+        // Known kinds of the slots in the frame being inferred, missing is unknown
+        using Kinds = std::unordered_map<uint32_t, Kind>;
+
+        // Kind of the value node evaluates to, types is updated to after it ran
+        Kind infer(ASTNode *node, Kinds &types);
+        void infer_while(Block *block, Kinds &types);
+        // Keeps in into only what it agrees on with other
+        static void join(Kinds &into, const Kinds &other);
+
+        // Off while looking for the kinds at a loop head, nodes are left as they are
+        bool annotate = true;
+};
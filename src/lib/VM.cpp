@@ -0,0 +1,209 @@
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include "VM.hpp"
+#include "ASTNode.hpp"
+#include "Exception.hpp"
+#include "ValueSum.hpp"
+
+// Unboxing helpers, same checks and messages as the evaluator
+static inline double as_number(const ValueSum &val) { return get_number(val); }
+static inline bool as_bool(const ValueSum &val) { return get_bool(val); }
+
+Bytecode::VM::VM(Chunk chunk, Output &output) : chunk(std::move(chunk)), output(output) {
+    reserve(1024);
+    stack.reserve(256);
+}
+
+void Bytecode::VM::reserve(size_t size) {
+    if (size <= slots.size())
+        return;
+    size = std::max(size, 2 * slots.size());
+    slots.resize(size, ValueSum::unbound());
+}
+
+void Bytecode::VM::run() {
+    const Instruction *code = chunk.code.data();
+    size_t pc = 0;
+    uint32_t scope = 0;
+    // Current frame, globals first
+    size_t base = 0, top = chunk.scopes[0].names.size();
+    reserve(top);
+    ValueSum *env = slots.data();
+    std::vector<PendingCall> callees;   // calls whose arguments are being evaluated
+
+    // Pops both operands of a binary operation, a is the left hand side
+    auto operands = [&](ValueSum &a, ValueSum &b) {
+        b = stack.back(); stack.pop_back();
+        a = stack.back(); stack.pop_back();
+    };
+    ValueSum a, b;
+
+    for (;;) {
+        const Instruction &ins = code[pc++];
+        switch (ins.op) {
+            case OpCode::constant:
+                stack.push_back(chunk.constants[ins.arg]);
+                break;
+            case OpCode::load:
+                if (!is_bound(env[ins.arg]))
+                    throw RuntimeError("Runtime error: unknown identifier " + chunk.scopes[scope].names[ins.arg]);
+                stack.push_back(env[ins.arg]);
+                break;
+            case OpCode::store:
+                env[ins.arg] = stack.back();
+                break;
+            case OpCode::pop:
+                stack.pop_back();
+                break;
+            case OpCode::add:
+                operands(a, b);
+                stack.push_back(ValueSum{as_number(a) + as_number(b)});
+                break;
+            case OpCode::sub:
+                operands(a, b);
+                stack.push_back(ValueSum{as_number(a) - as_number(b)});
+                break;
+            case OpCode::mul:
+                operands(a, b);
+                stack.push_back(ValueSum{as_number(a) * as_number(b)});
+                break;
+            case OpCode::div:
+                operands(a, b);
+                if (as_number(b) == 0)
+                    throw RuntimeError("Runtime error: division by zero.");
+                stack.push_back(ValueSum{as_number(a) / as_number(b)});
+                break;
+            case OpCode::mod:
+                operands(a, b);
+                if (as_number(b) == 0)
+                    throw RuntimeError("Runtime error: division by zero.");
+                stack.push_back(ValueSum{std::fmod(as_number(a), as_number(b))});
+                break;
+            case OpCode::less:
+                operands(a, b);
+                stack.push_back(ValueSum{as_number(a) < as_number(b)});
+                break;
+            case OpCode::less_equal:
+                operands(a, b);
+                stack.push_back(ValueSum{as_number(a) <= as_number(b)});
+                break;
+            case OpCode::greater:
+                operands(a, b);
+                stack.push_back(ValueSum{as_number(a) > as_number(b)});
+                break;
+            case OpCode::greater_equal:
+                operands(a, b);
+                stack.push_back(ValueSum{as_number(a) >= as_number(b)});
+                break;
+            case OpCode::equal:
+            case OpCode::not_equal: {
+                operands(a, b);
+                bool eq;
+                if (is_number(a) && is_number(b))
+                    eq = number_of(a) == number_of(b);
+                else if (is_bool(a) && is_bool(b))
+                    eq = bool_of(a) == bool_of(b);
+                else { // comparing values of different type
+                    stack.push_back(ValueSum{false});
+                    break;
+                }
+                stack.push_back(ValueSum{ins.op == OpCode::equal ? eq : !eq});
+                break;
+            }
+            case OpCode::logic_and:
+                operands(a, b);
+                stack.push_back(ValueSum{as_bool(a) && as_bool(b)});
+                break;
+            case OpCode::logic_xor:
+                operands(a, b);
+                stack.push_back(ValueSum{as_bool(a) != as_bool(b)});
+                break;
+            case OpCode::logic_or:
+                operands(a, b);
+                stack.push_back(ValueSum{as_bool(a) || as_bool(b)});
+                break;
+            case OpCode::jump:
+                pc = ins.arg;
+                break;
+            case OpCode::jump_if_false: {
+                if (!is_bool(stack.back()))
+                    throw RuntimeError("Runtime error: condition is not a bool.");
+                bool taken = !bool_of(stack.back());
+                stack.pop_back();
+                if (taken)
+                    pc = ins.arg;
+                break;
+            }
+            case OpCode::print:
+                output.write(vsum_to_string(stack.back()));
+                output.put('\n');
+                stack.pop_back();
+                break;
+            case OpCode::def: {
+                // A new function value with the captured variables of the enclosing frame
+                const Proto &proto = chunk.protos[ins.arg];
+                Closure *closure = closures.make(proto.node, ins.arg, chunk.scopes[proto.scope].names.size(), env,
+                                                 proto.name_slot, proto.captures.data(), proto.captures.size());
+                env[proto.name_slot] = ValueSum{closure};
+                break;
+            }
+            case OpCode::call_begin: {
+                const CallSite &site = chunk.calls[ins.arg];
+                if (!is_function(env[site.name_slot]))
+                    throw RuntimeError("Runtime error: not a function.");
+                Closure *closure = get_function(env[site.name_slot]);
+                uint32_t callee = chunk.proto_index.at(closure->def);
+                const Proto &proto = chunk.protos[callee];
+                if (proto.params.size() != site.argc)
+                    throw RuntimeError("Runtime error: incorrect argument count.");
+                // New frame on top of the stack, seeded with the captured closure
+                size_t size = chunk.scopes[proto.scope].names.size();
+                reserve(top + size);
+                env = slots.data() + base;
+                std::copy(closure->values, closure->values + size, slots.begin() + top);
+                callees.push_back(PendingCall{callee, top});
+                top += size;
+                break;
+            }
+            case OpCode::set_arg: {
+                const PendingCall &call = callees.back();
+                size_t slot = call.base + chunk.protos[call.proto].params[ins.arg];
+                slots[slot] = stack.back();
+                stack.pop_back();
+                break;
+            }
+            case OpCode::call: {
+                const PendingCall call = callees.back();
+                callees.pop_back();
+                if (frames.size() == MAX_FRAMES)
+                    throw RuntimeError("Runtime error: maximum call depth exceeded.");
+                frames.push_back(CallFrame{pc, scope, base});
+                scope = chunk.protos[call.proto].scope;
+                base = call.base;
+                env = slots.data() + base;
+                pc = chunk.protos[call.proto].entry;
+                break;
+            }
+            case OpCode::ret_null:
+                stack.push_back(ValueSum{nullptr});
+                [[fallthrough]];
+            case OpCode::ret:
+                // The return value is already on top of the caller's operands
+                if (frames.empty())
+                    return;
+                top = base;
+                pc = frames.back().return_pc;
+                scope = frames.back().scope;
+                base = frames.back().base;
+                env = slots.data() + base;
+                frames.pop_back();
+                break;
+            case OpCode::invalid_assignee:
+                throw RuntimeError("Runtime error: invalid assignee.");
+            case OpCode::halt:
+                return;
+        }
+    }
+}
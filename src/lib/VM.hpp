@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Bytecode.hpp"
+#include "Closure.hpp"
+#include "Output.hpp"
+#include "ValueSum.hpp"
+
+namespace Bytecode {
+
+// Stack machine executing a Chunk produced by Bytecode::Compiler.
+// Prints go to output, errors are thrown as the tree-walking evaluator does.
+class VM {
+    public:
+        // Calls nested deeper than this are an error, as they are for the evaluator
+        static constexpr size_t MAX_FRAMES = 1 << 20;
+
+        VM(Chunk chunk, Output &output);
+
+        void run();
+
+    private:
+        struct CallFrame {
+            size_t return_pc;
+            uint32_t scope;
+            size_t base;
+        };
+        // Frame allocated by call_begin while the arguments are evaluated
+        struct PendingCall {
+            uint32_t proto;
+            size_t base;
+        };
+
+        // Grows the slot stack to hold at least size slots
+        void reserve(size_t size);
+
+        Chunk chunk;
+        Output &output;
+        Closures closures;  // Function values made by defs
+        // Slots of all active frames, contiguous, the global frame comes first
+        std::vector<ValueSum> slots;  // ValueSum::unbound() until assigned
+        std::vector<ValueSum> stack;
+        std::vector<CallFrame> frames;
+};
+
+}
@@ -1,26 +1,82 @@
 #pragma once
 
-#include <variant>
-#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
 #include <string>
+#include <type_traits>
 
-#include "ASTNode.hpp"
 
-class Function;
+struct Closure;
 
-struct ValueSum : public std::variant<
-    double,
-    bool,
-    std::nullptr_t,
-    std::weak_ptr<Function>> {
+// A value in one 64-bit word (NaN boxing). Numbers are stored as plain doubles.
+// Everything else lives in the payload of a quiet NaN with bit 50 set, which
+// arithmetic never produces: null, false and true are small constants and a
+// function has the sign bit set with the pointer to its Closure in the low 48 bits.
+// Frames mark slots that hold no variable with the unbound constant.
+struct ValueSum {
+    static constexpr uint64_t SIGN      = 0x8000000000000000;
+    static constexpr uint64_t QNAN      = 0x7ffc000000000000;
+    static constexpr uint64_t NAN_BITS  = 0x7ff8000000000000;
+    static constexpr uint64_t NULL_BITS    = QNAN | 1;
+    static constexpr uint64_t FALSE_BITS   = QNAN | 2;
+    static constexpr uint64_t TRUE_BITS    = QNAN | 3;
+    static constexpr uint64_t UNBOUND_BITS = QNAN | 4;
+    static constexpr uint64_t POINTER_MASK = 0x0000ffffffffffff;
 
+    ValueSum() : bits(0) {}  // 0.0
+    explicit ValueSum(double number) {
+        std::memcpy(&bits, &number, sizeof bits);
+        // A NaN that would read as a boxed value becomes the plain one, sign kept
+        if ((bits & QNAN) == QNAN)
+            bits = (bits & SIGN) | NAN_BITS;
+    }
+    explicit ValueSum(bool boolean) : bits(boolean ? TRUE_BITS : FALSE_BITS) {}
+    explicit ValueSum(std::nullptr_t) : bits(NULL_BITS) {}
+    explicit ValueSum(Closure *function)
+        : bits(SIGN | QNAN | reinterpret_cast<uintptr_t>(function)) {}
+
+    static ValueSum unbound() { ValueSum val; val.bits = UNBOUND_BITS; return val; }
+
+    uint64_t bits;
 };
+static_assert(sizeof(ValueSum) == 8 && std::is_trivially_copyable<ValueSum>::value, "ValueSum is one word");
+
+inline bool is_bool(const ValueSum &val) { return (val.bits | 1) == ValueSum::TRUE_BITS; }
+inline bool is_number(const ValueSum &val) { return (val.bits & ValueSum::QNAN) != ValueSum::QNAN; }
+inline bool is_null(const ValueSum &val) { return val.bits == ValueSum::NULL_BITS; }
+inline bool is_function(const ValueSum &val) {
+    return (val.bits & (ValueSum::SIGN | ValueSum::QNAN)) == (ValueSum::SIGN | ValueSum::QNAN);
+}
+inline bool is_bound(const ValueSum &val) { return val.bits != ValueSum::UNBOUND_BITS; }
+
+// Unchecked access, for values whose type is known, e.g. proven by TypeInference
+inline double number_of(const ValueSum &val) {
+    double number;
+    std::memcpy(&number, &val.bits, sizeof number);
+    return number;
+}
+inline bool bool_of(const ValueSum &val) { return val.bits == ValueSum::TRUE_BITS; }
+inline Closure *function_of(const ValueSum &val) {
+    return reinterpret_cast<Closure *>(val.bits & ValueSum::POINTER_MASK);
+}
+
+// Throws the runtime error for an operand of the wrong type
+[[noreturn]] void invalid_operand();
 
-bool is_bool(ValueSum val);
-bool is_number(ValueSum val);
-bool is_null(ValueSum val);
-bool is_function(ValueSum val);
-bool get_bool(ValueSum val);
-double get_number(ValueSum val);
-std::shared_ptr<Function> get_function(ValueSum val);
-std::string vsum_to_string(ValueSum val);
\ No newline at end of file
+inline bool get_bool(const ValueSum &val) {
+    if (!is_bool(val))
+        invalid_operand();
+    return bool_of(val);
+}
+inline double get_number(const ValueSum &val) {
+    if (!is_number(val))
+        invalid_operand();
+    return number_of(val);
+}
+inline Closure *get_function(const ValueSum &val) {
+    if (!is_function(val))
+        invalid_operand();
+    return function_of(val);
+}
+std::string vsum_to_string(const ValueSum &val);
@@ -5,18 +5,78 @@
 #include <cctype>
 #include <iomanip>
 #include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <fstream>
+#include <unistd.h>
 
 #include "./lib/Lexer.hpp"
+#include "./lib/Source.hpp"
 #include "./lib/Exception.hpp"
 #include "./lib/Infix.hpp"
 #include "./lib/Scrypt.hpp"
+#include "./lib/Bytecode.hpp"
+#include "./lib/VM.hpp"
+#include "./lib/Output.hpp"
+#include "./lib/Optimizer.hpp"
+#include "./lib/TypeInference.hpp"
+#include "./lib/Jit.hpp"
+#include "./lib/Profiler.hpp"
+#include "./lib/Stats.hpp"
 
-int main() {
+int main(int argc, char *argv[]) {
+    // Written when main returns if SCRYPT_STATS is set
+    Stats stats("scrypt");
+    // --vm runs the program on the bytecode VM instead of the tree-walking evaluator
+    bool use_vm = false;
+    // --no-opt runs the program as parsed, without constant folding or type inference
+    bool optimize = true;
+    // --no-jit interprets everything, hot loops and functions are compiled otherwise
+    bool use_jit = true;
+    // --profile[=PREFIX] times every line and function call and writes
+    // PREFIX.txt and PREFIX.folded on exit, everything is interpreted meanwhile
+    std::string profile;
+    // The program is read from stdin unless a file is given
+    std::string path;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--vm") use_vm = true;
+        else if (arg == "--no-opt") optimize = false;
+        else if (arg == "--no-jit") use_jit = false;
+        else if (arg == "--profile") profile = "scrypt-profile";
+        else if (arg.rfind("--profile=", 0) == 0) profile = arg.substr(10);
+        else path = argv[i];
+    }
+    if (!profile.empty() && use_vm) {
+        std::cerr << "--profile only works with the evaluator, ignoring --vm" << std::endl;
+        use_vm = false;
+    }
+
+    // Line buffered on a terminal, so prints show up as they happen
+    Output output(std::cout, isatty(STDOUT_FILENO) ? Output::Mode::line : Output::Mode::full);
+    std::unique_ptr<Source> source;
+    std::shared_ptr<Program> x;  // Outlives the profiler, which refers to it
+    std::unique_ptr<Profiler> profiler;
+    // Written on the way out, after a runtime error too
+    auto write_profile = [&] {
+        if (!profiler)
+            return;
+        std::ofstream report(profile + ".txt"), stacks(profile + ".folded");
+        profiler->report(report, source->text());
+        profiler->collapsed(stacks);
+        if (!report || !stacks)
+            std::cerr << "Cannot write the profile to " << profile << ".txt and .folded" << std::endl;
+    };
     Lexer lexer;
-    std::deque<Token> tokens;
+    TokenStream tokens;
 
     try {
-        tokens = lexer.tokenize(std::cin);
+        source = path.empty() ? std::make_unique<Source>(std::cin) : std::make_unique<Source>(path);
+        {
+            Stats::Timer timer(stats, Stats::Phase::lex);
+            tokens = lexer.tokenize(source->text());
+        }
+        stats.count_tokens(tokens.size());
 
         // for (Token token : tokens) {
         //     std::cout << std::right << std::setw(4) << token.line_number 
@@ -25,15 +85,48 @@ int main() {
         // }
 
         Scrypt::Parser parser(tokens);
-        auto x = parser.parse();
-        x->eval();
-        std::cout << GLOBAL_COUT.str();
+        {
+            Stats::Timer timer(stats, Stats::Phase::parse);
+            x = parser.parse();
+        }
+        // Every slot is resolved by now, environments do not grow while running
+        stats.count_nodes(x->locations.size());
+        stats.arena(x->arena.bytes_reserved());
+        for (auto &env : x->environments)
+            stats.environment(env->values.size());
+        if (optimize) {
+            Stats::Timer timer(stats, Stats::Phase::optimize);
+            Optimizer().optimize(*x);
+            TypeInference().infer(*x);
+        }
+        Stats::Timer timer(stats, Stats::Phase::eval);
+        if (use_vm) {
+            Bytecode::Compiler compiler;
+            Bytecode::VM vm(compiler.compile(x->root), output);
+            vm.run();
+        }
+        else if (!profile.empty()) {
+            profiler = std::make_unique<Profiler>(*x);
+            x->eval(output, nullptr, profiler.get());
+            write_profile();
+        }
+        else {
+            Jit jit;
+            x->eval(output, use_jit ? &jit : nullptr);
+        }
     }
     catch(ScryptException& e) {
         // print any accumulated print messages after a runtime error
-        std::cout << GLOBAL_COUT.str();
+        output.flush();
+        write_profile();
         std::cout << e.what() << std::endl;
+        stats.exit_code(e.code());
         return e.code();  // Exit with the error code from the exception
     }
+    catch(std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        stats.exit_code(1);
+        return 1;
+    }
     return 0;
 }
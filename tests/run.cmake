@@ -0,0 +1,9 @@
+# Runs PROGRAM on INPUT with the flag in MODE, if any, and compares stdout to EXPECTED
+execute_process(
+    COMMAND ${PROGRAM} ${MODE} ${INPUT}
+    OUTPUT_VARIABLE output
+    RESULT_VARIABLE status)
+file(READ ${EXPECTED} expected)
+if(NOT output STREQUAL expected)
+    message(FATAL_ERROR "${INPUT} ${MODE}: exit ${status}, output:\n${output}\nexpected:\n${expected}")
+endif()